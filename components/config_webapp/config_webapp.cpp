@@ -747,6 +747,32 @@ esp_err_t config_webapp_start(const char *nvs_namespace,
     return ESP_OK;
 }
 
+esp_err_t config_webapp_register_get_handler(const char *uri, esp_err_t (*handler)(httpd_req_t *req))
+{
+    if (uri == nullptr || handler == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_ctx.server == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    httpd_uri_t get_uri = {
+        .uri = uri,
+        .method = HTTP_GET,
+        .handler = handler,
+        .user_ctx = nullptr,
+    };
+
+    esp_err_t result = httpd_register_uri_handler(s_ctx.server, &get_uri);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Nelze zaregistrovat %s: %s", uri, esp_err_to_name(result));
+        return result;
+    }
+
+    ESP_LOGI(TAG, "Zaregistrovana stranka %s", uri);
+    return ESP_OK;
+}
+
 esp_err_t config_webapp_get_i32(const char *key, int32_t *value)
 {
     if (key == nullptr || value == nullptr) {
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "esp_err.h"
+#include "esp_http_server.h"
 
 typedef enum {
     CONFIG_VALUE_STRING = 0,
@@ -62,3 +63,6 @@ esp_err_t config_webapp_set_i32(const char *key, int32_t value);
 esp_err_t config_webapp_set_float(const char *key, float value);
 esp_err_t config_webapp_set_bool(const char *key, bool value);
 esp_err_t config_webapp_set_string(const char *key, const char *value);
+
+// Prida dalsi GET stranku do bezici konfiguracni webove aplikace (napr. diagnostika).
+esp_err_t config_webapp_register_get_handler(const char *uri, esp_err_t (*handler)(httpd_req_t *req));
@@ -0,0 +1,151 @@
+#include "emulated_flash.h"
+
+#include <cstring>
+#include <numeric>
+
+namespace power_cut {
+namespace {
+bool s_armed = false;
+uint64_t s_remaining = 0;
+}
+
+void arm(uint64_t operations)
+{
+    s_armed = true;
+    s_remaining = operations;
+}
+
+void disarm()
+{
+    s_armed = false;
+}
+
+bool armed()
+{
+    return s_armed;
+}
+
+bool due()
+{
+    if (!s_armed) {
+        return false;
+    }
+    if (s_remaining > 0) {
+        --s_remaining;
+        return false;
+    }
+    s_armed = false;
+    return true;
+}
+
+}
+
+EmulatedFlashRegion::EmulatedFlashRegion(size_t size, uint32_t seed)
+    : data_(size, 0xFF),
+      erase_counts_(size / SECTOR_SIZE, 0),
+      rng_(seed),
+      writes_(0),
+      write_violations_(0),
+      map_supported_(true)
+{
+}
+
+size_t EmulatedFlashRegion::size() const
+{
+    return data_.size();
+}
+
+esp_err_t EmulatedFlashRegion::read(size_t offset, void *data, size_t length)
+{
+    if (offset > data_.size() || length > data_.size() - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    std::memcpy(data, data_.data() + offset, length);
+    return ESP_OK;
+}
+
+esp_err_t EmulatedFlashRegion::write(size_t offset, const void *data, size_t length)
+{
+    if (offset > data_.size() || length > data_.size() - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const uint8_t *source = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; ++i) {
+        if ((source[i] & ~data_[offset + i]) != 0) {
+            ++write_violations_;
+        }
+    }
+    ++writes_;
+
+    if (!power_cut::due()) {
+        for (size_t i = 0; i < length; ++i) {
+            data_[offset + i] &= source[i];
+        }
+        return ESP_OK;
+    }
+
+    // Dokoncene bajty, v rozpracovanem se stihla naprogramovat jen cast bitu
+    const size_t done = rng_() % (length + 1);
+    for (size_t i = 0; i < done; ++i) {
+        data_[offset + i] &= source[i];
+    }
+    if (done < length) {
+        data_[offset + done] &= static_cast<uint8_t>(source[done] | rng_());
+    }
+    throw PowerCut{};
+}
+
+esp_err_t EmulatedFlashRegion::erase(size_t offset, size_t length)
+{
+    if (offset % SECTOR_SIZE != 0 || length % SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > data_.size() || length > data_.size() - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const bool cut = power_cut::due();
+    // Pri vypadku se sektory nestihnou vsechny, posledni zacaty zustane napul
+    const size_t sectors = length / SECTOR_SIZE;
+    const size_t sectors_done = cut ? rng_() % (sectors + 1) : sectors;
+    for (size_t sector = 0; sector < sectors_done; ++sector) {
+        const size_t start = offset + sector * SECTOR_SIZE;
+        ++erase_counts_[start / SECTOR_SIZE];
+        std::memset(data_.data() + start, 0xFF, SECTOR_SIZE);
+    }
+    if (!cut) {
+        return ESP_OK;
+    }
+
+    if (sectors_done < sectors) {
+        const size_t start = offset + sectors_done * SECTOR_SIZE;
+        ++erase_counts_[start / SECTOR_SIZE];
+        for (size_t i = 0; i < SECTOR_SIZE; ++i) {
+            if (rng_() % 2 != 0) {
+                data_[start + i] = 0xFF;
+            }
+        }
+    }
+    throw PowerCut{};
+}
+
+esp_err_t EmulatedFlashRegion::map(size_t offset, size_t length, const void **data, uint32_t *handle)
+{
+    if (!map_supported_) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (offset > data_.size() || length > data_.size() - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    *data = data_.data() + offset;
+    *handle = 1;
+    return ESP_OK;
+}
+
+uint64_t EmulatedFlashRegion::total_erases() const
+{
+    return std::accumulate(erase_counts_.begin(), erase_counts_.end(), uint64_t{0});
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "flash_region.h"
+
+// Vypadek napajeni uprostred operace. Test ho chyti, zahodi stav citace
+// v RAM a citac znovu inicializuje nad tim, co zustalo ve flash a v NVS.
+struct PowerCut {};
+
+// Odpocet operaci do vypadku, spolecny pro emulovanou flash i NVS. Pocita se
+// kazdy zapis, mazani a nvs_commit; cteni ne.
+namespace power_cut {
+
+// Vypadek nastane behem operace cislo operations (0 = hned pristi)
+void arm(uint64_t operations);
+void disarm();
+bool armed();
+
+// Volaji emulatory na zacatku kazde operace; true = tahle operace se nedokonci
+bool due();
+
+}
+
+// Emulace NOR flash v RAM:
+// - zapis jen nuluje bity (AND se starym obsahem), pokus o prepis 0 -> 1
+//   se zapocte do write_violations() - na skutecnem cipu by bit zustal 0
+// - mazani jen po celych sektorech 4 KB, pocita se pro kazdy sektor zvlast
+// - pri vypadku se zapis provede jen z casti (nahodny pocet bajtu, v poslednim
+//   nahodne bity) a mazani nastavi na 0xFF jen nahodne bajty sektoru
+class EmulatedFlashRegion : public FlashRegion {
+public:
+    static constexpr size_t SECTOR_SIZE = 4096;
+
+    explicit EmulatedFlashRegion(size_t size, uint32_t seed = 1);
+
+    size_t size() const override;
+    esp_err_t read(size_t offset, void *data, size_t length) override;
+    esp_err_t write(size_t offset, const void *data, size_t length) override;
+    esp_err_t erase(size_t offset, size_t length) override;
+    esp_err_t map(size_t offset, size_t length, const void **data, uint32_t *handle) override;
+
+    // false = map() vraci ESP_ERR_NOT_SUPPORTED (jako bez volnych MMU stranek)
+    void set_map_supported(bool supported) { map_supported_ = supported; }
+
+    // Primy pristup pro pripravu obsahu v testech (napr. puvodni format citace)
+    uint8_t *data() { return data_.data(); }
+
+    size_t sector_count() const { return erase_counts_.size(); }
+    uint32_t sector_erases(size_t sector) const { return erase_counts_[sector]; }
+    uint64_t total_erases() const;
+    uint64_t writes() const { return writes_; }
+    uint64_t write_violations() const { return write_violations_; }
+
+private:
+    std::vector<uint8_t> data_;
+    std::vector<uint32_t> erase_counts_;
+    std::mt19937 rng_;
+    uint64_t writes_;
+    uint64_t write_violations_;
+    bool map_supported_;
+};
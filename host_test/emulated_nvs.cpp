@@ -0,0 +1,142 @@
+#include "emulated_nvs.h"
+#include "emulated_flash.h"
+
+#include "nvs.h"
+
+#include <map>
+#include <string>
+
+namespace {
+
+struct OpenHandle {
+    std::string namespace_name;
+    bool writable;
+    std::map<std::string, int64_t> staged;
+};
+
+// Klic "namespace/klic"; i64 a u8 sdili jeden prostor jako v NVS
+std::map<std::string, int64_t> s_committed;
+std::map<nvs_handle_t, OpenHandle> s_handles;
+nvs_handle_t s_next_handle = 1;
+
+std::string full_key(const OpenHandle &handle, const char *key)
+{
+    return handle.namespace_name + "/" + key;
+}
+
+esp_err_t get_value(nvs_handle_t handle, const char *key, int64_t *value)
+{
+    auto open = s_handles.find(handle);
+    if (open == s_handles.end() || key == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const std::string name = full_key(open->second, key);
+    auto staged = open->second.staged.find(name);
+    if (staged != open->second.staged.end()) {
+        *value = staged->second;
+        return ESP_OK;
+    }
+    auto committed = s_committed.find(name);
+    if (committed == s_committed.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *value = committed->second;
+    return ESP_OK;
+}
+
+esp_err_t set_value(nvs_handle_t handle, const char *key, int64_t value)
+{
+    auto open = s_handles.find(handle);
+    if (open == s_handles.end() || key == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!open->second.writable) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    open->second.staged[full_key(open->second, key)] = value;
+    return ESP_OK;
+}
+
+}
+
+void emulated_nvs_erase_all()
+{
+    s_committed.clear();
+    s_handles.clear();
+}
+
+extern "C" {
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (namespace_name == nullptr || out_handle == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Cteni z namespace, do ktereho se jeste nic nezapsalo, NVS odmitne
+    const std::string prefix = std::string(namespace_name) + "/";
+    if (open_mode == NVS_READONLY) {
+        auto first = s_committed.lower_bound(prefix);
+        if (first == s_committed.end() || first->first.compare(0, prefix.size(), prefix) != 0) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+    }
+
+    const nvs_handle_t handle = s_next_handle++;
+    s_handles[handle] = OpenHandle{namespace_name, open_mode == NVS_READWRITE, {}};
+    *out_handle = handle;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    s_handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    auto open = s_handles.find(handle);
+    if (open == s_handles.end()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (power_cut::due()) {
+        s_handles.clear();
+        throw PowerCut{};
+    }
+
+    for (const auto &entry : open->second.staged) {
+        s_committed[entry.first] = entry.second;
+    }
+    open->second.staged.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i64(nvs_handle_t handle, const char *key, int64_t *out_value)
+{
+    return get_value(handle, key, out_value);
+}
+
+esp_err_t nvs_set_i64(nvs_handle_t handle, const char *key, int64_t value)
+{
+    return set_value(handle, key, value);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    int64_t value = 0;
+    esp_err_t result = get_value(handle, key, &value);
+    if (result == ESP_OK) {
+        *out_value = static_cast<uint8_t>(value);
+    }
+    return result;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return set_value(handle, key, value);
+}
+
+}
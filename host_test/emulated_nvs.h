@@ -0,0 +1,9 @@
+#pragma once
+
+// NVS v RAM pro hostitelsky build (nvs.h). Zmeny se drzi v otevrenem handle
+// a do ulozeneho stavu se dostanou az pri nvs_commit; vypadek napajeni
+// (power_cut) pri commitu je zahodi cele. Skutecna NVS je atomicka jen po
+// jednotlivych klicich, emulace je v tom mirnejsi nez cip.
+
+// Smaze vsechny klice (prvni start zarizeni)
+void emulated_nvs_erase_all();
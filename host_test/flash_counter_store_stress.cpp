@@ -0,0 +1,154 @@
+// Stress test FlashCounterStore nad emulovanou NOR flash s vypadky napajeni:
+// nahodne prirustky a flush(), po vypadku musi kazdy kanal lezet mezi
+// poslednim potvrzenym stavem a hodnotou pred prerusenym flush(). Na konci
+// zmena sady kanalu (pridani a odebrani) nesmi zmenit hodnoty ostatnich.
+//
+// Pouziti: flash_counter_store_stress [pocet_flush] [seed]
+
+#include "emulated_flash.h"
+#include "flash_counter_store.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <random>
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+            std::exit(1);                                                         \
+        }                                                                         \
+    } while (0)
+
+namespace {
+
+constexpr const char *STORE_NAME = "user_data1";
+constexpr size_t PARTITION_SIZE = 0x2000;
+
+struct ChannelSpec {
+    const char *name;
+    uint32_t units_per_step;
+    uint32_t max_add;
+};
+
+constexpr std::array<ChannelSpec, 4> CHANNELS = {{
+    {"boot", 1, 2},
+    {"energy", 10, 200},
+    {"run", 60, 200},
+    {"extra", 5, 20},
+}};
+
+std::mt19937_64 s_rng;
+
+void maybe_arm_power_cut(unsigned one_in, unsigned max_operations)
+{
+    if (s_rng() % one_in == 0) {
+        power_cut::arm(s_rng() % max_operations);
+    } else {
+        power_cut::disarm();
+    }
+}
+
+void boot(std::optional<FlashCounterStore> &store, EmulatedFlashRegion &flash, size_t channel_count)
+{
+    for (;;) {
+        try {
+            store.emplace();
+            for (size_t i = 0; i < channel_count; ++i) {
+                size_t channel = 0;
+                CHECK(store->add_channel(CHANNELS[i].name, CHANNELS[i].units_per_step, &channel) == ESP_OK);
+                CHECK(channel == i);
+            }
+            CHECK(store->init(flash, STORE_NAME) == ESP_OK);
+            power_cut::disarm();
+            return;
+        } catch (const PowerCut &) {
+            maybe_arm_power_cut(3, 3);
+        }
+    }
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t flush_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 300000;
+    s_rng.seed(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1);
+
+    constexpr size_t channel_count = 3;
+    EmulatedFlashRegion flash(PARTITION_SIZE);
+    std::optional<FlashCounterStore> store;
+    boot(store, flash, channel_count);
+
+    std::array<uint64_t, channel_count> confirmed = {};
+    uint64_t flushes = 0;
+    uint64_t power_cuts = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < flush_count; ++i) {
+        std::array<uint64_t, channel_count> before = {};
+        for (size_t channel = 0; channel < channel_count; ++channel) {
+            CHECK(store->add(channel, s_rng() % CHANNELS[channel].max_add) == ESP_OK);
+            before[channel] = store->value(channel);
+        }
+
+        maybe_arm_power_cut(40, 3);
+        try {
+            CHECK(store->flush() == ESP_OK);
+            power_cut::disarm();
+            ++flushes;
+            for (size_t channel = 0; channel < channel_count; ++channel) {
+                const uint64_t persisted = store->persisted_value(channel);
+                CHECK(persisted >= confirmed[channel] && persisted <= before[channel]);
+                CHECK(before[channel] - persisted < CHANNELS[channel].units_per_step);
+                confirmed[channel] = persisted;
+            }
+        } catch (const PowerCut &) {
+            ++power_cuts;
+            maybe_arm_power_cut(3, 3);
+            boot(store, flash, channel_count);
+            for (size_t channel = 0; channel < channel_count; ++channel) {
+                const uint64_t recovered = store->persisted_value(channel);
+                if (recovered < confirmed[channel] || recovered > before[channel]) {
+                    std::printf("FAIL after power cut: channel=%zu confirmed=%" PRIu64 " recovered=%" PRIu64
+                                " before=%" PRIu64 "\n",
+                                channel, confirmed[channel], recovered, before[channel]);
+                    return 1;
+                }
+                confirmed[channel] = recovered;
+            }
+        }
+        CHECK(flash.write_violations() == 0);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Pridani kanalu zachova ostatni, novy zacina od nuly
+    boot(store, flash, 4);
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+        CHECK(store->persisted_value(channel) == confirmed[channel]);
+    }
+    CHECK(store->persisted_value(3) == 0);
+    CHECK(store->add(3, 7) == ESP_OK);
+    CHECK(store->flush() == ESP_OK);
+    boot(store, flash, 4);
+    CHECK(store->persisted_value(3) == 5);
+
+    // Odebrani kanalu
+    boot(store, flash, channel_count);
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+        CHECK(store->persisted_value(channel) == confirmed[channel]);
+    }
+    CHECK(flash.write_violations() == 0);
+
+    std::printf("store ok: flushes=%" PRIu64 " power_cuts=%" PRIu64 " %.0f flush/s values=%" PRIu64 " %" PRIu64
+                " %" PRIu64 "\n",
+                flushes, power_cuts, static_cast<double>(flushes) / seconds,
+                confirmed[0], confirmed[1], confirmed[2]);
+    std::printf("  writes=%" PRIu64 " erases=%" PRIu64 " (%" PRIu32 ", %" PRIu32 ")\n",
+                flash.writes(), flash.total_erases(), flash.sector_erases(0), flash.sector_erases(1));
+    return 0;
+}
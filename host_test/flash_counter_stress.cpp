@@ -0,0 +1,211 @@
+// Stress test FlashMonotonicCounter nad emulovanou NOR flash s vypadky
+// napajeni: prevod z puvodniho formatu a miliony nahodnych kroku. Po kazdem
+// vypadku musi hodnota lezet mezi poslednim potvrzenym stavem a tim, co
+// rozpracovany krok pridaval - citac nesmi couvnout ani poskocit.
+//
+// Pouziti: flash_counter_stress [pocet_volani_increment] [seed]
+
+#include "emulated_flash.h"
+#include "emulated_nvs.h"
+#include "flash_bits.h"
+#include "flash_monotonic_counter.h"
+
+#include "nvs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <random>
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            std::printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+            std::exit(1);                                                         \
+        }                                                                         \
+    } while (0)
+
+namespace {
+
+constexpr const char *COUNTER_NAME = "flow_data0";
+constexpr size_t PARTITION_SIZE = 0x2000;   // flow_data0 v partitions.csv
+
+std::mt19937_64 s_rng;
+
+// Vypadek pri nekterem pristim zapisu/mazani, jinak bez vypadku
+void maybe_arm_power_cut(unsigned one_in, unsigned max_operations)
+{
+    if (s_rng() % one_in == 0) {
+        power_cut::arm(s_rng() % max_operations);
+    } else {
+        power_cut::disarm();
+    }
+}
+
+// Start zarizeni; vypadek muze prijit i behem init (prevod, nedokonceny rollover)
+uint64_t boot(std::optional<FlashMonotonicCounter> &counter, EmulatedFlashRegion &flash)
+{
+    for (;;) {
+        try {
+            counter.emplace();
+            CHECK(counter->init(flash, COUNTER_NAME) == ESP_OK);
+            power_cut::disarm();
+            return counter->value();
+        } catch (const PowerCut &) {
+            maybe_arm_power_cut(4, 4);
+        }
+    }
+}
+
+void save_legacy_nvs(int64_t base_value, bool pending)
+{
+    char base_key[16];
+    char pending_key[16];
+    const uint32_t hash = flash_bits::fnv1a32(COUNTER_NAME);
+    std::snprintf(base_key, sizeof(base_key), "b_%08" PRIx32, hash);
+    std::snprintf(pending_key, sizeof(pending_key), "p_%08" PRIx32, hash);
+
+    nvs_handle_t handle = 0;
+    CHECK(nvs_open("flash_ctr", NVS_READWRITE, &handle) == ESP_OK);
+    CHECK(nvs_set_i64(handle, base_key, base_value) == ESP_OK);
+    CHECK(nvs_set_u8(handle, pending_key, pending ? 1 : 0) == ESP_OK);
+    CHECK(nvs_commit(handle) == ESP_OK);
+    nvs_close(handle);
+}
+
+// Puvodni format: bity pres celou partition + zaklad v NVS
+void test_legacy_migration()
+{
+    for (int round = 0; round < 200; ++round) {
+        emulated_nvs_erase_all();
+        EmulatedFlashRegion flash(PARTITION_SIZE, static_cast<uint32_t>(round));
+        const uint32_t legacy_bits = static_cast<uint32_t>(s_rng() % (PARTITION_SIZE * 8));
+        flash_bits::clear_bits(flash.data(), 0, legacy_bits);
+        const int64_t legacy_base = static_cast<int64_t>(s_rng() % 1000000);
+        save_legacy_nvs(legacy_base, false);
+
+        std::optional<FlashMonotonicCounter> counter;
+        maybe_arm_power_cut(2, 6);
+        const uint64_t migrated = boot(counter, flash);
+        CHECK(migrated == static_cast<uint64_t>(legacy_base) + legacy_bits);
+        CHECK(flash.write_violations() == 0);
+
+        // Po prevodu uz se NVS nepouziva, citac pokracuje v kruhu
+        CHECK(counter->increment(3) == ESP_OK);
+        CHECK(boot(counter, flash) == migrated + 3);
+    }
+
+    // Vypadek behem mazani v puvodnim rolloveru: plati jen zaklad z NVS
+    emulated_nvs_erase_all();
+    EmulatedFlashRegion flash(PARTITION_SIZE);
+    for (size_t i = 0; i < PARTITION_SIZE; i += 3) {
+        flash.data()[i] = 0x5A;
+    }
+    save_legacy_nvs(777, true);
+    std::optional<FlashMonotonicCounter> counter;
+    CHECK(boot(counter, flash) == 777);
+
+    std::printf("legacy migration ok\n");
+}
+
+void test_random_increments(uint64_t increments)
+{
+    emulated_nvs_erase_all();
+    EmulatedFlashRegion flash(PARTITION_SIZE);
+    std::optional<FlashMonotonicCounter> counter;
+    uint64_t confirmed = boot(counter, flash);
+    CHECK(confirmed == 0);
+
+    uint64_t done = 0;
+    uint64_t power_cuts = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (done < increments) {
+        const uint32_t steps = 1 + static_cast<uint32_t>(s_rng() % 5);
+        maybe_arm_power_cut(50, 4);
+        try {
+            CHECK(counter->increment(steps) == ESP_OK);
+            power_cut::disarm();
+            confirmed += steps;
+            CHECK(counter->value() == confirmed);
+        } catch (const PowerCut &) {
+            ++power_cuts;
+            maybe_arm_power_cut(4, 4);
+            const uint64_t recovered = boot(counter, flash);
+            if (recovered < confirmed || recovered > confirmed + steps) {
+                std::printf("FAIL after power cut: confirmed=%" PRIu64 " steps=%" PRIu32 " recovered=%" PRIu64 "\n",
+                            confirmed, steps, recovered);
+                std::exit(1);
+            }
+            confirmed = recovered;
+        }
+        CHECK(flash.write_violations() == 0);
+        ++done;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Mazani se stridaji po kruhu, rozdil mezi sektory nejvys o par vypadku
+    uint32_t min_erases = UINT32_MAX;
+    uint32_t max_erases = 0;
+    for (size_t sector = 0; sector < flash.sector_count(); ++sector) {
+        min_erases = std::min(min_erases, flash.sector_erases(sector));
+        max_erases = std::max(max_erases, flash.sector_erases(sector));
+    }
+    CHECK(max_erases - min_erases <= 1 + power_cuts / 10);
+
+    std::printf("random increments ok: increments=%" PRIu64 " value=%" PRIu64 " power_cuts=%" PRIu64
+                " %.0f increments/s\n",
+                done, confirmed, power_cuts, static_cast<double>(done) / seconds);
+    std::printf("  writes=%" PRIu64 " erases=%" PRIu64 " (",
+                flash.writes(), flash.total_erases());
+    for (size_t sector = 0; sector < flash.sector_count(); ++sector) {
+        std::printf("%s%" PRIu32, sector == 0 ? "" : ", ", flash.sector_erases(sector));
+    }
+    std::printf(") counter reports %" PRIu64 "\n", counter->sector_erases());
+}
+
+void test_reset()
+{
+    emulated_nvs_erase_all();
+    EmulatedFlashRegion flash(PARTITION_SIZE);
+    std::optional<FlashMonotonicCounter> counter;
+    boot(counter, flash);
+    CHECK(counter->increment(40000) == ESP_OK);
+    const uint64_t before = counter->value();
+
+    // reset() drzi hodnotu v NVS, po vypadku je bud stara, nebo nula
+    for (int round = 0; round < 100; ++round) {
+        maybe_arm_power_cut(1, 6);
+        try {
+            CHECK(counter->reset() == ESP_OK);
+            power_cut::disarm();
+            CHECK(counter->value() == 0);
+            CHECK(counter->increment(40000) == ESP_OK);
+        } catch (const PowerCut &) {
+            const uint64_t recovered = boot(counter, flash);
+            CHECK(recovered == before || recovered == 0);
+            if (recovered == 0) {
+                CHECK(counter->increment(40000) == ESP_OK);
+            }
+        }
+        CHECK(counter->value() == before);
+        CHECK(flash.write_violations() == 0);
+    }
+
+    std::printf("reset ok\n");
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t increments = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    s_rng.seed(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1);
+
+    test_legacy_migration();
+    test_random_increments(increments);
+    test_reset();
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Benchmark pruchodu bitu citace na emulovane 64 KB partition:
+// - puvodni cesta: kopie po 256 B do bufferu a popcount po bajtech
+// - flash_bits::scan_region bez mapovani: stejny buffer, popcount po slovech
+// - flash_bits::scan_region nad namapovanou oblasti, bez kopirovani
+// a pro srovnani init FlashMonotonicCounter (hranice pulenim).
+//
+// Na hostiteli je "flash" v RAM, meri se tedy jen prace CPU; na ESP32 pridava
+// kazda cesta jeste cteni z SPI flash pres cache.
+//
+// Pouziti: flash_scan_bench [pocet_opakovani]
+
+#include "emulated_flash.h"
+#include "emulated_nvs.h"
+#include "flash_bits.h"
+#include "flash_monotonic_counter.h"
+
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+constexpr size_t PARTITION_SIZE = 64 * 1024;
+
+esp_err_t scan_bytewise(FlashRegion &flash, size_t offset, size_t size, uint32_t *zero_bits)
+{
+    std::array<uint8_t, flash_bits::SCAN_CHUNK_SIZE> buffer = {};
+    uint32_t count = 0;
+    size_t done = 0;
+    while (done < size) {
+        const size_t bytes_to_read = std::min(buffer.size(), size - done);
+        esp_err_t result = flash.read(offset + done, buffer.data(), bytes_to_read);
+        if (result != ESP_OK) {
+            return result;
+        }
+        for (size_t i = 0; i < bytes_to_read; ++i) {
+            count += __builtin_popcount(static_cast<uint8_t>(~buffer[i]));
+        }
+        done += bytes_to_read;
+    }
+
+    *zero_bits = count;
+    return ESP_OK;
+}
+
+template<typename Scan>
+double measure_ns(uint32_t iterations, Scan scan)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        scan();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+void report(const char *name, double ns)
+{
+    std::printf("  %-28s %10.0f ns  %8.1f MB/s\n", name, ns, PARTITION_SIZE / ns * 1e3);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t iterations = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 2000;
+
+    EmulatedFlashRegion flash(PARTITION_SIZE);
+    const uint32_t expected_bits = PARTITION_SIZE * 8 / 3;
+    flash_bits::clear_bits(flash.data(), 0, expected_bits);
+
+    uint32_t bytewise_bits = 0;
+    flash_bits::ScanState buffered;
+    flash_bits::ScanState mapped;
+
+    const double bytewise_ns = measure_ns(iterations, [&] {
+        scan_bytewise(flash, 0, PARTITION_SIZE, &bytewise_bits);
+    });
+    flash.set_map_supported(false);
+    const double buffered_ns = measure_ns(iterations, [&] {
+        buffered = flash_bits::ScanState();
+        flash_bits::scan_region(flash, 0, PARTITION_SIZE, buffered);
+    });
+    flash.set_map_supported(true);
+    const double mapped_ns = measure_ns(iterations, [&] {
+        mapped = flash_bits::ScanState();
+        flash_bits::scan_region(flash, 0, PARTITION_SIZE, mapped);
+    });
+
+    if (bytewise_bits != expected_bits || buffered.zero_bits != expected_bits || mapped.zero_bits != expected_bits
+        || buffered.holes != 0 || mapped.holes != 0 || mapped.used_end != expected_bits) {
+        std::printf("FAIL: expected %" PRIu32 " bits, bytewise %" PRIu32 " buffered %" PRIu32 " mapped %" PRIu32 "\n",
+                    expected_bits, bytewise_bits, buffered.zero_bits, mapped.zero_bits);
+        return 1;
+    }
+
+    // Kruh 16 sektoru, aktivni sektor zaplneny z poloviny
+    emulated_nvs_erase_all();
+    EmulatedFlashRegion counter_flash(PARTITION_SIZE);
+    FlashMonotonicCounter counter;
+    if (counter.init(counter_flash, "bench") != ESP_OK || counter.increment(16000) != ESP_OK) {
+        std::printf("FAIL: counter setup\n");
+        return 1;
+    }
+    const double init_ns = measure_ns(iterations, [&] {
+        FlashMonotonicCounter reloaded;
+        if (reloaded.init(counter_flash, "bench") != ESP_OK || reloaded.value() != 16000) {
+            std::printf("FAIL: counter reload\n");
+            std::exit(1);
+        }
+    });
+
+    std::printf("64 KB partition, %" PRIu32 " cleared bits, %" PRIu32 " runs:\n", expected_bits, iterations);
+    report("bytewise via 256 B buffer", bytewise_ns);
+    report("word-wide via 256 B buffer", buffered_ns);
+    report("word-wide mapped", mapped_ns);
+    std::printf("  %-28s %10.0f ns\n", "counter init (binary search)", init_ns);
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Benchmark TrimmedMean proti FenwickTrimmedMean pro ruzne velikosti okna.
+// Oba filtry dostavaji stejna 12bitova data (sum kolem hladiny, obcas
+// odlehla hodnota) a po kazdem vlozeni musi vratit stejny vysledek.
+// Meri se insert() + getValue(), jak je vola mereni hladiny.
+//
+// Pouziti: trimmed_mean_bench [pocet_vzorku]
+
+#include "trimmed_mean.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<uint32_t> make_samples(size_t count, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> samples(count);
+    for (auto &sample : samples) {
+        sample = (rng() % 20 == 0) ? rng() % 4096 : 1800 + rng() % 64;
+    }
+    return samples;
+}
+
+template<typename Filter>
+double measure_ns(const std::vector<uint32_t> &samples, uint64_t *checksum)
+{
+    auto filter = std::make_unique<Filter>();
+    uint64_t sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t sample : samples) {
+        filter->insert(sample);
+        sum += filter->getValue();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    *checksum = sum;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / samples.size();
+}
+
+template<size_t BufferSize, size_t TrimCount>
+bool run(size_t sample_count)
+{
+    // Shoda po kazdem vlozeni, vcetne rozbehu z bufferu plneho nul
+    const std::vector<uint32_t> check_samples = make_samples(4 * BufferSize + 1000, BufferSize);
+    auto reference = std::make_unique<TrimmedMean<BufferSize, TrimCount>>();
+    auto fenwick = std::make_unique<FenwickTrimmedMean<BufferSize, TrimCount>>();
+    for (size_t i = 0; i < check_samples.size(); ++i) {
+        reference->insert(check_samples[i]);
+        fenwick->insert(check_samples[i]);
+        if (reference->getValue() != fenwick->getValue()) {
+            std::printf("FAIL: window %zu sample %zu: TrimmedMean %lu, FenwickTrimmedMean %lu\n",
+                        BufferSize, i,
+                        static_cast<unsigned long>(reference->getValue()),
+                        static_cast<unsigned long>(fenwick->getValue()));
+            return false;
+        }
+    }
+
+    const std::vector<uint32_t> samples = make_samples(sample_count, 1);
+    uint64_t reference_checksum = 0;
+    uint64_t fenwick_checksum = 0;
+    const double reference_ns = measure_ns<TrimmedMean<BufferSize, TrimCount>>(samples, &reference_checksum);
+    const double fenwick_ns = measure_ns<FenwickTrimmedMean<BufferSize, TrimCount>>(samples, &fenwick_checksum);
+    if (reference_checksum != fenwick_checksum) {
+        std::printf("FAIL: window %zu checksum differs\n", BufferSize);
+        return false;
+    }
+
+    std::printf("  %6zu  %6zu  %12.1f ns  %12.1f ns\n", BufferSize, TrimCount, reference_ns, fenwick_ns);
+    return true;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const size_t sample_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+
+    std::printf("  %6s  %6s  %15s  %15s\n", "window", "trim", "TrimmedMean", "Fenwick");
+    bool ok = run<31, 5>(sample_count);
+    ok = run<256, 32>(sample_count) && ok;
+    ok = run<1024, 128>(sample_count) && ok;
+    ok = run<4096, 512>(sample_count) && ok;
+    return ok ? 0 : 1;
+}
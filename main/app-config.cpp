@@ -294,6 +294,32 @@ esp_err_t app_config_load_runtime_flags(void)
     return ESP_OK;
 }
 
+esp_err_t app_config_load_interval_s(uint32_t *interval_s)
+{
+    if (interval_s == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t result = nvs_open(APP_CFG_NAMESPACE, NVS_READONLY, &handle);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    int32_t value = 0;
+    result = nvs_get_i32(handle, "interval_s", &value);
+    nvs_close(handle);
+    if (result != ESP_OK) {
+        return result;
+    }
+    if (value < 5) {
+        value = 5;
+    }
+
+    *interval_s = (uint32_t)value;
+    return ESP_OK;
+}
+
 esp_err_t app_config_load_mqtt_uri(char *uri, size_t uri_len)
 {
     if (uri == nullptr || uri_len == 0) {
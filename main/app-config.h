@@ -2,6 +2,7 @@
 
 #include "config_webapp.h"
 #include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 config_group_t app_config_get_config_group(void);
@@ -10,4 +11,5 @@ esp_err_t app_config_load_wifi_credentials(char *ssid, size_t ssid_len, char *pa
 esp_err_t app_config_load_mqtt_uri(char *uri, size_t uri_len);
 esp_err_t app_config_load_mqtt_credentials(char *username, size_t username_len, char *password, size_t password_len);
 esp_err_t app_config_load_runtime_flags(void);
+esp_err_t app_config_load_interval_s(uint32_t *interval_s);
 bool app_config_is_service_mode(void);
@@ -0,0 +1,174 @@
+#include "diag_publisher.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <stdio.h>
+#include <atomic>
+
+#include "mqtt_init.h"
+#include "sensor_events.h"
+#include "tick_scheduler.h"
+
+#define TAG "DIAG"
+
+static constexpr size_t DIAG_MAX_PROVIDERS = 8;
+// Publikace QoS 1 ceka na zamek MQTT klienta a sit, proto bezi ve vlastnim
+// tasku s nizkou prioritou a ne v pracovnim tasku planovace
+static constexpr uint32_t DIAG_TASK_STACK_SIZE = 4096;
+static constexpr UBaseType_t DIAG_TASK_PRIORITY = 2;
+
+static diag_provider_fn s_providers[DIAG_MAX_PROVIDERS] = {};
+// Registrovat lze i za behu, uloha vidi jen plne zapsane polozky
+static std::atomic<size_t> s_provider_count{0};
+static tick_job_t *s_job = nullptr;
+static TaskHandle_t s_task = nullptr;
+
+static void publish_system_diag(void)
+{
+    char payload[24];
+    snprintf(payload, sizeof(payload), "%lu", (unsigned long)(esp_timer_get_time() / 1000000LL));
+    diag_publish("uptime_s", payload);
+
+    snprintf(payload, sizeof(payload), "%lu", (unsigned long)esp_get_free_heap_size());
+    diag_publish("free_heap_b", payload);
+}
+
+static void publish_event_bus_diag(void)
+{
+    char subtopic[48];
+    char payload[256];
+
+    for (size_t topic = 0; topic < EVENT_TOPIC_COUNT; ++topic) {
+        sensor_events_topic_stats_t stats = {};
+        sensor_events_get_topic_stats(static_cast<event_topic_t>(topic), &stats);
+
+        const unsigned long latency_avg_us =
+            stats.received > 0 ? (unsigned long)(stats.latency_sum_us / stats.received) : 0UL;
+
+        int written = snprintf(payload,
+                               sizeof(payload),
+                               "{\"published\":%lu,\"dropped\":%lu,\"coalesced\":%lu,\"received\":%lu,"
+                               "\"latency_avg_us\":%lu,\"latency_max_us\":%lu,\"latency_hist_ms\":[",
+                               (unsigned long)stats.published,
+                               (unsigned long)stats.dropped,
+                               (unsigned long)stats.coalesced,
+                               (unsigned long)stats.received,
+                               latency_avg_us,
+                               (unsigned long)stats.latency_max_us);
+        for (size_t bucket = 0; bucket < SENSOR_EVENTS_LATENCY_BUCKETS && written > 0 && (size_t)written < sizeof(payload); ++bucket) {
+            written += snprintf(payload + written,
+                                sizeof(payload) - written,
+                                bucket == 0 ? "%lu" : ",%lu",
+                                (unsigned long)stats.latency_histogram[bucket]);
+        }
+        if (written > 0 && (size_t)written < sizeof(payload)) {
+            snprintf(payload + written, sizeof(payload) - written, "]}");
+        }
+
+        snprintf(subtopic, sizeof(subtopic), "event_bus/%s", sensor_event_topic_name(static_cast<event_topic_t>(topic)));
+        diag_publish(subtopic, payload);
+    }
+
+    uint32_t control_capacity = 0;
+    uint32_t telemetry_capacity = 0;
+    const uint32_t control_hwm = sensor_events_queue_high_watermark(EVENT_LANE_CONTROL, &control_capacity);
+    const uint32_t telemetry_hwm = sensor_events_queue_high_watermark(EVENT_LANE_TELEMETRY, &telemetry_capacity);
+    snprintf(payload,
+             sizeof(payload),
+             "{\"control\":%lu,\"control_capacity\":%lu,\"telemetry\":%lu,\"telemetry_capacity\":%lu}",
+             (unsigned long)control_hwm,
+             (unsigned long)control_capacity,
+             (unsigned long)telemetry_hwm,
+             (unsigned long)telemetry_capacity);
+    diag_publish("event_bus/queue_high_watermark", payload);
+}
+
+static void diag_task(void *arg)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!mqtt_is_connected()) {
+            continue;
+        }
+
+        publish_system_diag();
+        publish_event_bus_diag();
+        const size_t provider_count = s_provider_count.load(std::memory_order_acquire);
+        for (size_t index = 0; index < provider_count; ++index) {
+            s_providers[index]();
+        }
+    }
+}
+
+// Uloha planovace - jen probudi task diagnostiky, sama nikdy neblokuje.
+// Kdyz predchozi kolo jeste bezi, notifikace se slouci do jedne.
+static void diag_job(void *arg)
+{
+    xTaskNotifyGive(s_task);
+}
+
+esp_err_t diag_publisher_register(diag_provider_fn provider)
+{
+    if (provider == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const size_t count = s_provider_count.load(std::memory_order_relaxed);
+    if (count >= DIAG_MAX_PROVIDERS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_providers[count] = provider;
+    s_provider_count.store(count + 1, std::memory_order_release);
+    return ESP_OK;
+}
+
+esp_err_t diag_publish(const char *subtopic, const char *payload)
+{
+    if (subtopic == nullptr || payload == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char topic[96];
+    const int written = snprintf(topic, sizeof(topic), DIAG_TOPIC_ROOT "%s", subtopic);
+    if (written <= 0 || (size_t)written >= sizeof(topic)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return mqtt_publish(topic, payload, true);
+}
+
+esp_err_t diag_publisher_start(uint32_t period_ms)
+{
+    if (period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_job != nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (xTaskCreate(diag_task, TAG, DIAG_TASK_STACK_SIZE, NULL, DIAG_TASK_PRIORITY, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_job = tick_scheduler_add_job(TAG, period_ms, diag_job, NULL);
+    if (s_job == nullptr) {
+        vTaskDelete(s_task);
+        s_task = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Diagnostika se publikuje kazdych %lu ms", (unsigned long)period_ms);
+    return ESP_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define DIAG_TOPIC_ROOT "home/water_tank/diag/"
+
+// Zdroj diagnostiky - pri kazdem kole publikuje sve hodnoty pres diag_publish().
+// Bezi v tasku diagnostiky, sdileny stav cte jen pres atomiky nebo kopii pod zamkem.
+typedef void (*diag_provider_fn)(void);
+
+/**
+ * Zaregistruje dalsi zdroj diagnostiky. Lze volat pred i po diag_publisher_start()
+ * (registrace neni chranena proti soubeznemu volani, volat z inicializace).
+ */
+esp_err_t diag_publisher_register(diag_provider_fn provider);
+
+/**
+ * Publikuje hodnotu na home/water_tank/diag/<subtopic> (QoS 1, retain).
+ */
+esp_err_t diag_publish(const char *subtopic, const char *payload);
+
+/**
+ * Spusti periodickou publikaci diagnostiky. Ulohu tick_scheduler jen budi
+ * task diagnostiky s nizkou prioritou, ktery publikuje (blokujici MQTT).
+ * @param period_ms perioda publikace v milisekundach
+ */
+esp_err_t diag_publisher_start(uint32_t period_ms);
@@ -0,0 +1,267 @@
+#include "event_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <freertos/FreeRTOS.h>
+#include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config_webapp.h"
+
+#define TAG "EVENT_TRACE"
+
+static_assert(sizeof(event_trace_record_t) == 16, "Zaznam trasovani ma mit 16 B");
+
+static constexpr uint32_t TRACE_STORAGE_MAGIC = 0x46524543UL;  // "CERF"
+
+// Uloziste v no-init RAM - neprepisuje se pri startu, takze po resetu
+// obsahuje historii z predchoziho behu
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t write_index;    // celkovy pocet zapsanych zaznamu
+    uint32_t write_index_check;
+    event_trace_record_t records[EVENT_TRACE_CAPACITY];
+} trace_storage_t;
+
+static __NOINIT_ATTR trace_storage_t s_trace;
+static portMUX_TYPE s_trace_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_trace_ready = false;
+
+static void encode_record(const app_event_t *event, event_trace_record_t *record)
+{
+    memset(record, 0, sizeof(*record));
+    record->timestamp_ms = static_cast<uint32_t>(event->timestamp_us / 1000);
+    record->event_type = static_cast<uint8_t>(event->event_type);
+
+    switch (event->event_type) {
+        case EVT_SENSOR: {
+            const sensor_event_t &sensor = event->data.sensor;
+            record->subtype = static_cast<uint8_t>(sensor.sensor_type);
+            switch (sensor.sensor_type) {
+                case SENSOR_EVENT_TEMPERATURE:
+                    record->payload.f[0] = sensor.data.temperature.temperature_c;
+                    break;
+                case SENSOR_EVENT_LEVEL:
+                    record->aux = static_cast<int16_t>(sensor.data.level.raw_value);
+                    record->payload.f[0] = sensor.data.level.height_m;
+                    record->payload.f[1] = sensor.data.level.volume_l;
+                    break;
+                case SENSOR_EVENT_FLOW:
+                    record->payload.f[0] = sensor.data.flow.flow_l_min;
+                    record->payload.f[1] = sensor.data.flow.total_volume_l;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        case EVT_NETWORK:
+            record->subtype = static_cast<uint8_t>(event->data.network.level);
+            record->aux = event->data.network.last_rssi;
+            record->payload.u[0] = event->data.network.ip_addr;
+            break;
+        default:
+            break;
+    }
+}
+
+void event_trace_decode(const event_trace_record_t *record, app_event_t *event)
+{
+    memset(event, 0, sizeof(*event));
+    event->event_type = static_cast<event_type_t>(record->event_type);
+    event->timestamp_us = static_cast<int64_t>(record->timestamp_ms) * 1000;
+
+    switch (event->event_type) {
+        case EVT_SENSOR: {
+            sensor_event_t &sensor = event->data.sensor;
+            sensor.sensor_type = static_cast<sensor_event_type_t>(record->subtype);
+            switch (sensor.sensor_type) {
+                case SENSOR_EVENT_TEMPERATURE:
+                    sensor.data.temperature.temperature_c = record->payload.f[0];
+                    break;
+                case SENSOR_EVENT_LEVEL:
+                    sensor.data.level.raw_value = static_cast<uint16_t>(record->aux);
+                    sensor.data.level.height_m = record->payload.f[0];
+                    sensor.data.level.volume_l = record->payload.f[1];
+                    break;
+                case SENSOR_EVENT_FLOW:
+                    sensor.data.flow.flow_l_min = record->payload.f[0];
+                    sensor.data.flow.total_volume_l = record->payload.f[1];
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        case EVT_NETWORK:
+            event->data.network.level = static_cast<system_network_level_t>(record->subtype);
+            event->data.network.last_rssi = static_cast<int8_t>(record->aux);
+            event->data.network.ip_addr = record->payload.u[0];
+            break;
+        default:
+            break;
+    }
+}
+
+static void append_record(const event_trace_record_t *record)
+{
+    taskENTER_CRITICAL(&s_trace_lock);
+    s_trace.records[s_trace.write_index % EVENT_TRACE_CAPACITY] = *record;
+    s_trace.write_index += 1;
+    s_trace.write_index_check = ~s_trace.write_index;
+    taskEXIT_CRITICAL(&s_trace_lock);
+}
+
+void event_trace_init(void)
+{
+    const esp_reset_reason_t reason = esp_reset_reason();
+    const bool ram_retained = reason != ESP_RST_POWERON
+                           && reason != ESP_RST_BROWNOUT
+                           && reason != ESP_RST_UNKNOWN;
+    const bool storage_valid = s_trace.magic == TRACE_STORAGE_MAGIC
+                            && s_trace.capacity == EVENT_TRACE_CAPACITY
+                            && s_trace.write_index_check == ~s_trace.write_index;
+
+    if (ram_retained && storage_valid) {
+        ESP_LOGW(TAG,
+                 "Zachovan letovy zaznam z predchoziho behu: %lu zaznamu",
+                 (unsigned long)(s_trace.write_index < EVENT_TRACE_CAPACITY ? s_trace.write_index : EVENT_TRACE_CAPACITY));
+    } else {
+        memset(&s_trace, 0, sizeof(s_trace));
+        s_trace.magic = TRACE_STORAGE_MAGIC;
+        s_trace.capacity = EVENT_TRACE_CAPACITY;
+        s_trace.write_index_check = ~s_trace.write_index;
+    }
+
+    event_trace_record_t marker = {};
+    marker.event_type = EVENT_TRACE_BOOT_MARKER;
+    marker.subtype = static_cast<uint8_t>(reason);
+    s_trace_ready = true;
+    append_record(&marker);
+}
+
+void event_trace_record(const app_event_t *event)
+{
+    if (event == nullptr || !s_trace_ready) {
+        return;
+    }
+
+    event_trace_record_t record;
+    encode_record(event, &record);
+    append_record(&record);
+}
+
+static uint32_t current_write_index(void)
+{
+    taskENTER_CRITICAL(&s_trace_lock);
+    const uint32_t write_index = s_trace.write_index;
+    taskEXIT_CRITICAL(&s_trace_lock);
+    return write_index;
+}
+
+// Precte zaznam s poradim index; false pokud uz byl mezitim prepsan
+static bool read_record(uint32_t index, event_trace_record_t *record)
+{
+    taskENTER_CRITICAL(&s_trace_lock);
+    const bool overwritten = (s_trace.write_index - index) > EVENT_TRACE_CAPACITY;
+    *record = s_trace.records[index % EVENT_TRACE_CAPACITY];
+    taskEXIT_CRITICAL(&s_trace_lock);
+    return !overwritten;
+}
+
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    const uint32_t end = current_write_index();
+    const uint32_t count = end < EVENT_TRACE_CAPACITY ? end : EVENT_TRACE_CAPACITY;
+
+    httpd_resp_set_type(req, "text/plain; charset=utf-8");
+
+    char line[144];
+    for (uint32_t index = end - count; index != end; ++index) {
+        event_trace_record_t record;
+        if (!read_record(index, &record)) {
+            continue;  // behem vypisu uz prepsano novejsim eventem
+        }
+
+        if (record.event_type == EVENT_TRACE_BOOT_MARKER) {
+            snprintf(line, sizeof(line), "--- start, reset_reason=%d ---\n", (int)record.subtype);
+        } else {
+            app_event_t event;
+            event_trace_decode(&record, &event);
+            sensor_event_to_string(&event, line, sizeof(line) - 1);
+            strcat(line, "\n");
+        }
+
+        esp_err_t result = httpd_resp_sendstr_chunk(req, line);
+        if (result != ESP_OK) {
+            return result;
+        }
+    }
+
+    return httpd_resp_sendstr_chunk(req, nullptr);
+}
+
+static esp_err_t trace_bin_get_handler(httpd_req_t *req)
+{
+    const uint32_t end = current_write_index();
+    const uint32_t count = end < EVENT_TRACE_CAPACITY ? end : EVENT_TRACE_CAPACITY;
+
+    const event_trace_dump_header_t header = {
+        .magic = EVENT_TRACE_DUMP_MAGIC,
+        .version = EVENT_TRACE_DUMP_VERSION,
+        .record_size = sizeof(event_trace_record_t),
+        .record_count = count,
+        .write_index = end,
+    };
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"event_trace.bin\"");
+
+    esp_err_t result = httpd_resp_send_chunk(req, reinterpret_cast<const char *>(&header), sizeof(header));
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    // Odesila se po blocich, aby se zbytecne nedrzel zamek ani velky buffer
+    event_trace_record_t chunk[32];
+    uint32_t index = end - count;
+    while (index != end) {
+        size_t filled = 0;
+        while (filled < sizeof(chunk) / sizeof(chunk[0]) && index != end) {
+            if (!read_record(index, &chunk[filled])) {
+                // prepsany zaznam nahradime prazdnym, aby sedel pocet z hlavicky
+                memset(&chunk[filled], 0, sizeof(chunk[filled]));
+                chunk[filled].event_type = EVENT_TRACE_LOST_RECORD;
+            }
+            ++filled;
+            ++index;
+        }
+
+        result = httpd_resp_send_chunk(req, reinterpret_cast<const char *>(chunk), filled * sizeof(chunk[0]));
+        if (result != ESP_OK) {
+            return result;
+        }
+    }
+
+    return httpd_resp_send_chunk(req, nullptr, 0);
+}
+
+esp_err_t event_trace_register_http(void)
+{
+    esp_err_t result = config_webapp_register_get_handler("/trace", trace_get_handler);
+    if (result != ESP_OK) {
+        return result;
+    }
+    return config_webapp_register_get_handler("/trace.bin", trace_bin_get_handler);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sensor_events.h"
+
+// Kompaktni binarni zaznam eventu - formatuje se az pri cteni trasovani
+typedef struct {
+    uint32_t timestamp_ms;
+    uint8_t event_type;     // event_type_t
+    uint8_t subtype;        // sensor_event_type_t / system_network_level_t
+    int16_t aux;            // RAW hladiny / RSSI
+    union {
+        float f[2];
+        uint32_t u[2];
+    } payload;
+} event_trace_record_t;
+
+// Letovy zapisovac: ~32 KB v no-init RAM, preziji softwarovy reset i pad.
+// Pri soucasnem provozu (prutok 5 Hz, teplota 1 Hz, hladina pri zmene) pokryje
+// nekolik poslednich minut.
+#define EVENT_TRACE_CAPACITY 2048
+
+// Zvlastni zaznam oddelujici starty - subtype nese esp_reset_reason_t
+#define EVENT_TRACE_BOOT_MARKER 0xFF
+// Zaznam prepsany behem stahovani binarniho vypisu
+#define EVENT_TRACE_LOST_RECORD 0xFE
+
+// Hlavicka binarniho vypisu /trace.bin (little-endian), za ni nasleduji
+// zaznamy od nejstarsiho; dekoder: tools/decode_event_trace.py
+typedef struct {
+    uint32_t magic;          // EVENT_TRACE_DUMP_MAGIC
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t record_count;
+    uint32_t write_index;    // celkovy pocet zapsanych zaznamu
+} event_trace_dump_header_t;
+
+#define EVENT_TRACE_DUMP_MAGIC 0x52545645UL  // "EVTR"
+#define EVENT_TRACE_DUMP_VERSION 1
+
+/**
+ * Obnovi zaznamy z predchoziho behu (po softwarovem resetu) nebo buffer vymaze
+ * (po zapnuti napajeni). Volat co nejdrive po startu.
+ */
+void event_trace_init(void);
+
+/**
+ * Prida event do kruhoveho bufferu. Jen kopie do zaznamu, bez formatovani.
+ */
+void event_trace_record(const app_event_t *event);
+
+/**
+ * Rozbali zaznam zpet na app_event_t (cas s presnosti na ms).
+ */
+void event_trace_decode(const event_trace_record_t *record, app_event_t *event);
+
+/**
+ * Zaregistruje HTTP stranky /trace (text) a /trace.bin (binarni vypis).
+ */
+esp_err_t event_trace_register_http(void);
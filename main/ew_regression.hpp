@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cmath>
+
+/**
+ * Lineární regrese hodnoty na čase s exponenciálním zapomínáním
+ * (klouzavé okno bez ukládání vzorků)
+ *
+ * Váha vzorku klesá s jeho stářím jako exp(-stáří / TimeConstant), takže
+ * okno je zhruba posledních několik časových konstant. Každé vložení stojí
+ * O(1): drží se jen vážené průměry a středované součty (Welfordův tvar, bez
+ * odečítání velkých čísel i ve floatu). Počátek času je vždy u posledního
+ * vzorku, čas tedy neroste donekonečna.
+ *
+ * Příklad:
+ *   EwRegression volume_trend(1800.0f);   // časová konstanta 30 min
+ *   volume_trend.insert(elapsed_s, volume_l);
+ *   float rate_l_s = volume_trend.getSlope();
+ */
+class EwRegression
+{
+private:
+    float time_constant_s;
+    float weight;          // součet vah
+    float weight_sq;       // součet čtverců vah (efektivní počet vzorků)
+    float mean_t;          // vážený průměr času vůči poslednímu vzorku (<= 0)
+    float mean_y;
+    float sum_tt;          // středované součty
+    float sum_ty;
+    float sum_yy;
+
+public:
+    /**
+     * @param time_constant_s časová konstanta zapomínání v sekundách
+     */
+    explicit EwRegression(float time_constant_s) : time_constant_s(time_constant_s)
+    {
+        reset();
+    }
+
+    /**
+     * Zapomene všechny vzorky
+     */
+    void reset()
+    {
+        weight = 0.0f;
+        weight_sq = 0.0f;
+        mean_t = 0.0f;
+        mean_y = 0.0f;
+        sum_tt = 0.0f;
+        sum_ty = 0.0f;
+        sum_yy = 0.0f;
+    }
+
+    /**
+     * Vloží vzorek
+     *
+     * @param elapsed_s čas od předchozího vzorku (první vzorek libovolný)
+     * @param value hodnota
+     */
+    void insert(float elapsed_s, float value)
+    {
+        if (elapsed_s < 0.0f)
+        {
+            elapsed_s = 0.0f;
+        }
+        const float decay = weight > 0.0f ? expf(-elapsed_s / time_constant_s) : 0.0f;
+
+        // Stárnutí a posun počátku na nový vzorek (t = 0)
+        weight *= decay;
+        weight_sq *= decay * decay;
+        sum_tt *= decay;
+        sum_ty *= decay;
+        sum_yy *= decay;
+        mean_t -= elapsed_s;
+
+        weight += 1.0f;
+        weight_sq += 1.0f;
+        const float dt = 0.0f - mean_t;
+        const float dy = value - mean_y;
+        mean_t += dt / weight;
+        mean_y += dy / weight;
+        sum_tt += dt * (0.0f - mean_t);
+        sum_ty += dt * (value - mean_y);
+        sum_yy += dy * (value - mean_y);
+    }
+
+    /**
+     * Vrátí efektivní počet vzorků v okně
+     *
+     * @return (součet vah)^2 / součet čtverců vah
+     */
+    float getEffectiveCount() const
+    {
+        return weight_sq > 0.0f ? weight * weight / weight_sq : 0.0f;
+    }
+
+    /**
+     * Vrátí směrnici (změnu hodnoty za sekundu)
+     *
+     * @return směrnice, 0 dokud vzorky nepokrývají žádný čas
+     */
+    float getSlope() const
+    {
+        return sum_tt > 0.0f ? sum_ty / sum_tt : 0.0f;
+    }
+
+    /**
+     * Vrátí odhad hodnoty v čase posledního vzorku podle přímky
+     *
+     * @return vyrovnaná hodnota
+     */
+    float getValue() const
+    {
+        return mean_y - getSlope() * mean_t;
+    }
+
+    /**
+     * Vrátí směrodatnou chybu směrnice z rozptylu reziduí
+     *
+     * Rezidua sousedních vzorků bývají korelovaná (filtry před regresí),
+     * skutečná chyba pak může být větší.
+     *
+     * @return chyba směrnice, INFINITY při méně než 3 efektivních vzorcích
+     */
+    float getSlopeStdError() const
+    {
+        const float count = getEffectiveCount();
+        if (count <= 2.0f || !(sum_tt > 0.0f))
+        {
+            return INFINITY;
+        }
+        const float residual = sum_yy - getSlope() * sum_ty;
+        const float variance = (residual > 0.0f ? residual : 0.0f) / weight * count / (count - 2.0f);
+        return sqrtf(variance * (weight_sq / weight) / sum_tt);
+    }
+
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+// Spolecne pomucky pro citace, ktere v NOR flash nuluji bity poporade
+// (FlashMonotonicCounter, FlashCounterStore).
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "esp_err.h"
+#include "flash_region.h"
+
+namespace flash_bits {
+
+constexpr size_t SECTOR_SIZE = 4096;
+constexpr size_t SCAN_CHUNK_SIZE = 256;
+
+struct ScanState {
+    uint32_t zero_bits = 0;
+    uint32_t holes = 0;          // slova porusujici souvisly prefix vynulovanych bitu
+    uint32_t used_end = 0;       // bit za poslednim vynulovanym bitem
+    uint32_t scanned_bits = 0;
+    bool frontier_seen = false;
+};
+
+// Nulove bity maji tvorit souvisly prefix; cokoli jineho je zapis preruseny
+// vypadkem napajeni nebo poskozeni flash
+inline void scan_words(const uint32_t *words, size_t count, ScanState &state)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t cleared = ~words[i];
+        state.zero_bits += __builtin_popcount(cleared);
+        if (cleared != 0) {
+            state.used_end = state.scanned_bits + 32 - __builtin_clz(cleared);
+        }
+        state.scanned_bits += 32;
+
+        if (!state.frontier_seen) {
+            if (cleared == 0xFFFFFFFFu) {
+                continue;
+            }
+            state.frontier_seen = true;
+            // Rozpracovane slovo smi mit vynulovane jen nejnizsi bity
+            if ((cleared & (cleared + 1)) != 0) {
+                ++state.holes;
+            }
+        } else if (cleared != 0) {
+            ++state.holes;
+        }
+    }
+}
+
+inline esp_err_t scan_region(FlashRegion &flash, size_t offset, size_t size, ScanState &state)
+{
+    // Primo z oblasti namapovane do cache, bez kopirovani pres buffer
+    const void *mapped = nullptr;
+    uint32_t map_handle = 0;
+    esp_err_t result = flash.map(offset, size, &mapped, &map_handle);
+    if (result == ESP_OK) {
+        scan_words(static_cast<const uint32_t *>(mapped), size / sizeof(uint32_t), state);
+        flash.unmap(map_handle);
+        return ESP_OK;
+    }
+
+    // Nedostatek volnych MMU stranek nebo bez mapovani - po blocich pres buffer
+    std::array<uint32_t, SCAN_CHUNK_SIZE / sizeof(uint32_t)> buffer = {};
+    size_t done = 0;
+    while (done < size) {
+        const size_t bytes_to_read = std::min<size_t>(sizeof(buffer), size - done);
+        result = flash.read(offset + done, buffer.data(), bytes_to_read);
+        if (result != ESP_OK) {
+            return result;
+        }
+
+        scan_words(buffer.data(), bytes_to_read / sizeof(uint32_t), state);
+        done += bytes_to_read;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * Najde pulenim prvni slovo, ktere neni cele vynulovane. Plati pro souvisly
+ * prefix vynulovanych bitu; za vysledkem muze jeste lezet zbytek zapisu
+ * preruseneho vypadkem napajeni.
+ */
+inline esp_err_t find_prefix_frontier(FlashRegion &flash, size_t offset, size_t word_count, size_t *first_word)
+{
+    size_t low = 0;
+    size_t high = word_count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        uint32_t word = 0;
+        esp_err_t result = flash.read(offset + middle * sizeof(uint32_t), &word, sizeof(word));
+        if (result != ESP_OK) {
+            return result;
+        }
+
+        if (word == 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    *first_word = low;
+    return ESP_OK;
+}
+
+// Vynuluje v bufferu bity [start_bit, start_bit + bit_count), kde bit 0 je
+// LSB bajtu buffer[0]
+inline void clear_bits(uint8_t *buffer, uint32_t start_bit, uint32_t bit_count)
+{
+    const uint32_t end_bit = start_bit + bit_count;
+    for (uint32_t bit = start_bit; bit < end_bit; ++bit) {
+        buffer[bit / 8] = static_cast<uint8_t>(buffer[bit / 8] & ~(1U << (bit % 8)));
+    }
+}
+
+inline uint32_t fnv1a32(const void *data, size_t size, uint32_t hash = 2166136261u)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+inline uint32_t fnv1a32(const char *text)
+{
+    return fnv1a32(text, std::strlen(text));
+}
+
+// Poradova cisla se porovnavaji modulo 2^32
+inline bool sequence_newer(uint32_t candidate, uint32_t current)
+{
+    return static_cast<int32_t>(candidate - current) > 0;
+}
+
+}
@@ -0,0 +1,442 @@
+#include "flash_counter_store.h"
+#include "flash_bits.h"
+
+extern "C" {
+#include "esp_log.h"
+}
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+
+using namespace flash_bits;
+
+namespace {
+constexpr size_t SECTOR_HEADER_SIZE = 160;
+constexpr uint32_t SECTOR_MAGIC = 0x53544346; // "FCTS"
+constexpr const char *TAG = "COUNTER_STORE";
+
+struct StoreHeaderEntry {
+    uint32_t name_hash;
+    uint32_t units_per_step;
+    int64_t base_steps;
+};
+
+struct StoreHeader {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t channel_count;
+    uint32_t reserved;
+    StoreHeaderEntry entries[FlashCounterStore::MAX_CHANNELS];
+    uint32_t checksum;
+};
+
+static_assert(sizeof(StoreHeader) <= SECTOR_HEADER_SIZE, "hlavicka se nevejde");
+
+uint32_t header_checksum(const StoreHeader &header)
+{
+    return fnv1a32(&header, offsetof(StoreHeader, checksum));
+}
+
+esp_err_t read_header(FlashRegion &flash, uint32_t sector, StoreHeader *header, bool *valid)
+{
+    esp_err_t result = flash.read(static_cast<size_t>(sector) * SECTOR_SIZE, header, sizeof(*header));
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    *valid = header->magic == SECTOR_MAGIC
+          && header->channel_count > 0
+          && header->channel_count <= FlashCounterStore::MAX_CHANNELS
+          && header->checksum == header_checksum(*header);
+    return ESP_OK;
+}
+}
+
+FlashCounterStore::FlashCounterStore()
+    : partition_region_(),
+      flash_(nullptr),
+      channels_{},
+      channel_count_(0),
+      sector_count_(0),
+      active_sector_(0),
+      active_sequence_(0),
+      initialized_(false)
+{
+}
+
+esp_err_t FlashCounterStore::add_channel(const char *name, uint32_t units_per_step, size_t *out_channel)
+{
+    if (name == nullptr || name[0] == '\0' || units_per_step == 0 || out_channel == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (initialized_) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (channel_count_ >= MAX_CHANNELS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const uint32_t name_hash = fnv1a32(name);
+    for (size_t index = 0; index < channel_count_; ++index) {
+        if (channels_[index].name_hash == name_hash) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    Channel &channel = channels_[channel_count_];
+    channel = {};
+    channel.name = name;
+    channel.name_hash = name_hash;
+    channel.units_per_step = units_per_step;
+    *out_channel = channel_count_++;
+    return ESP_OK;
+}
+
+esp_err_t FlashCounterStore::init(const char *partition_label)
+{
+    esp_err_t result = partition_region_.open(partition_label);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    return init(partition_region_, partition_label);
+}
+
+esp_err_t FlashCounterStore::init(FlashRegion &flash, const char *name)
+{
+    if (name == nullptr || name[0] == '\0' || channel_count_ == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Kruh potrebuje aspon dva sektory - jeden drzi hodnoty, druhy se maze
+    if (flash.size() % SECTOR_SIZE != 0 || flash.size() < 2 * SECTOR_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    flash_ = &flash;
+    initialized_ = false;
+    sector_count_ = flash.size() / SECTOR_SIZE;
+
+    bool found = false;
+    bool layout_matches = false;
+    esp_err_t result = find_active_sector_(&found, &layout_matches);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    if (!found) {
+        ESP_LOGW(TAG, "Partition %s nema platny sektor, zakladam novy kruh", name);
+        result = start_fresh_ring_();
+    } else {
+        result = load_channels_from_layout_(active_sector_);
+        if (result == ESP_OK && !layout_matches) {
+            // Zmena sady kanalu - hodnoty se prenesou do dalsiho sektoru s novym
+            // rozdelenim; stary sektor plati, dokud nova hlavicka neni zapsana
+            ESP_LOGW(TAG, "Zmenena sada kanalu v %s, prevadim", name);
+            result = rollover_();
+        }
+    }
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    initialized_ = true;
+    for (size_t index = 0; index < channel_count_; ++index) {
+        ESP_LOGI(TAG,
+                 "Kanal %s = %llu",
+                 channels_[index].name,
+                 static_cast<unsigned long long>(persisted_value(index)));
+    }
+    return ESP_OK;
+}
+
+esp_err_t FlashCounterStore::add(size_t channel, uint64_t units)
+{
+    if (!initialized_ || channel >= channel_count_) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    Channel &target = channels_[channel];
+    const uint64_t total_units = static_cast<uint64_t>(target.residual_units) + units;
+    const uint64_t pending_steps = static_cast<uint64_t>(target.pending_steps) + total_units / target.units_per_step;
+    if (pending_steps > UINT32_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    target.pending_steps = static_cast<uint32_t>(pending_steps);
+    target.residual_units = static_cast<uint32_t>(total_units % target.units_per_step);
+    return ESP_OK;
+}
+
+esp_err_t FlashCounterStore::flush()
+{
+    if (!initialized_) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const uint32_t region_bits = static_cast<uint32_t>(region_bytes_(channel_count_) * 8);
+
+    while (true) {
+        bool any_pending = false;
+        bool needs_rollover = false;
+        for (size_t index = 0; index < channel_count_; ++index) {
+            const Channel &channel = channels_[index];
+            if (channel.pending_steps > 0) {
+                any_pending = true;
+                needs_rollover = needs_rollover || channel.used_bits >= region_bits;
+            }
+        }
+        if (!any_pending) {
+            return ESP_OK;
+        }
+
+        if (needs_rollover) {
+            esp_err_t result = rollover_();
+            if (result != ESP_OK) {
+                return result;
+            }
+        }
+
+        // Rozsah bajtu pres vsechny kanaly s nezapsanymi kroky
+        std::array<uint32_t, MAX_CHANNELS> write_bits = {};
+        size_t first_byte = SIZE_MAX;
+        size_t end_byte = 0;
+        for (size_t index = 0; index < channel_count_; ++index) {
+            const Channel &channel = channels_[index];
+            write_bits[index] = std::min(channel.pending_steps, region_bits - channel.used_bits);
+            if (write_bits[index] == 0) {
+                continue;
+            }
+
+            const size_t region = region_offset_(active_sector_, index, channel_count_);
+            first_byte = std::min(first_byte, region + channel.used_bits / 8);
+            end_byte = std::max(end_byte, region + (channel.used_bits + write_bits[index] + 7) / 8);
+        }
+
+        // Jeden zapis pres vsechny useky; bajty mezi nimi se slouci s obsahem
+        // flash, aby se nikde nezapisovala 1 pres uz vynulovany bit (kontrola
+        // zapisu v ESP-IDF by to odmitla)
+        const size_t span = end_byte - first_byte;
+        std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[span]);
+        if (!buffer) {
+            return ESP_ERR_NO_MEM;
+        }
+        esp_err_t read_result = flash_->read(first_byte, buffer.get(), span);
+        if (read_result != ESP_OK) {
+            return read_result;
+        }
+
+        for (size_t index = 0; index < channel_count_; ++index) {
+            if (write_bits[index] == 0) {
+                continue;
+            }
+            const size_t region = region_offset_(active_sector_, index, channel_count_);
+            const uint32_t start_bit = static_cast<uint32_t>((region - first_byte) * 8) + channels_[index].used_bits;
+            clear_bits(buffer.get(), start_bit, write_bits[index]);
+        }
+
+        esp_err_t result = flash_->write(first_byte, buffer.get(), span);
+        if (result != ESP_OK) {
+            return result;
+        }
+
+        for (size_t index = 0; index < channel_count_; ++index) {
+            channels_[index].used_bits += write_bits[index];
+            channels_[index].pending_steps -= write_bits[index];
+        }
+    }
+}
+
+uint64_t FlashCounterStore::value(size_t channel) const
+{
+    if (channel >= channel_count_) {
+        return 0;
+    }
+
+    const Channel &target = channels_[channel];
+    return persisted_value(channel)
+         + static_cast<uint64_t>(target.pending_steps) * target.units_per_step
+         + target.residual_units;
+}
+
+uint64_t FlashCounterStore::persisted_value(size_t channel) const
+{
+    if (channel >= channel_count_) {
+        return 0;
+    }
+
+    const Channel &target = channels_[channel];
+    const int64_t steps = target.base_steps + static_cast<int64_t>(target.used_bits);
+    return steps <= 0 ? 0 : static_cast<uint64_t>(steps) * target.units_per_step;
+}
+
+size_t FlashCounterStore::region_bytes_(size_t channel_count) const
+{
+    // Zarovnano na slova kvuli hledani hranice po 4 B
+    return ((SECTOR_SIZE - SECTOR_HEADER_SIZE) / channel_count) & ~static_cast<size_t>(3);
+}
+
+size_t FlashCounterStore::region_offset_(uint32_t sector, size_t channel, size_t channel_count) const
+{
+    return static_cast<size_t>(sector) * SECTOR_SIZE + SECTOR_HEADER_SIZE + channel * region_bytes_(channel_count);
+}
+
+esp_err_t FlashCounterStore::find_active_sector_(bool *found, bool *layout_matches)
+{
+    *found = false;
+    *layout_matches = false;
+
+    for (uint32_t sector = 0; sector < sector_count_; ++sector) {
+        StoreHeader header = {};
+        bool valid = false;
+        esp_err_t result = read_header(*flash_, sector, &header, &valid);
+        if (result != ESP_OK) {
+            return result;
+        }
+
+        if (valid && (!*found || sequence_newer(header.sequence, active_sequence_))) {
+            *found = true;
+            active_sector_ = sector;
+            active_sequence_ = header.sequence;
+
+            bool matches = header.channel_count == channel_count_;
+            for (size_t index = 0; matches && index < channel_count_; ++index) {
+                matches = header.entries[index].name_hash == channels_[index].name_hash
+                       && header.entries[index].units_per_step == channels_[index].units_per_step;
+            }
+            *layout_matches = matches;
+        }
+    }
+
+    return ESP_OK;
+}
+
+// Nacte hodnoty kanalu ze sektoru. Pri jinem rozdeleni kanaly paruje podle
+// jmena a prepocita na novou velikost kroku; zbytek mensi nez krok zustane
+// jen v RAM, dokud ho nedoplni dalsi prirustky.
+esp_err_t FlashCounterStore::load_channels_from_layout_(uint32_t sector)
+{
+    StoreHeader header = {};
+    bool valid = false;
+    esp_err_t result = read_header(*flash_, sector, &header, &valid);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    const size_t stored_count = header.channel_count;
+    const size_t stored_region_words = region_bytes_(stored_count) / sizeof(uint32_t);
+
+    for (size_t index = 0; index < channel_count_; ++index) {
+        Channel &channel = channels_[index];
+        channel.base_steps = 0;
+        channel.used_bits = 0;
+        channel.pending_steps = 0;
+        channel.residual_units = 0;
+
+        for (size_t stored = 0; stored < stored_count; ++stored) {
+            const StoreHeaderEntry &entry = header.entries[stored];
+            if (entry.name_hash != channel.name_hash) {
+                continue;
+            }
+
+            // flush() zapisuje vsechny kanaly jednim zapisem a pri vypadku
+            // napajeni z nej muze zustat libovolna cast bitu. Hodnota proto
+            // konci za poslednim vynulovanym bitem, ne poctem nul - dalsi
+            // flush diry preskoci a citac nesmi po startu couvnout. Useky
+            // jsou male a cteni jde pres mapovani, staci je projit cele.
+            const size_t region = region_offset_(sector, stored, stored_count);
+            ScanState state;
+            result = scan_region(*flash_, region, stored_region_words * sizeof(uint32_t), state);
+            if (result != ESP_OK) {
+                return result;
+            }
+            if (state.holes != 0) {
+                ESP_LOGW(TAG,
+                         "Kanal %s: nedokonceny zapis (%lu slov)",
+                         channel.name,
+                         static_cast<unsigned long>(state.holes));
+            }
+            const uint32_t used_bits = state.used_end;
+
+            if (stored == index && entry.units_per_step == channel.units_per_step && stored_count == channel_count_) {
+                channel.base_steps = entry.base_steps;
+                channel.used_bits = used_bits;
+            } else {
+                const int64_t steps = entry.base_steps + static_cast<int64_t>(used_bits);
+                const uint64_t units = steps <= 0 ? 0 : static_cast<uint64_t>(steps) * entry.units_per_step;
+                channel.base_steps = static_cast<int64_t>(units / channel.units_per_step);
+                channel.residual_units = static_cast<uint32_t>(units % channel.units_per_step);
+            }
+            break;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t FlashCounterStore::write_sector_header_(uint32_t sector, uint32_t sequence)
+{
+    StoreHeader header = {};
+    std::memset(&header, 0xFF, sizeof(header));
+    header.magic = SECTOR_MAGIC;
+    header.sequence = sequence;
+    header.channel_count = static_cast<uint32_t>(channel_count_);
+    header.reserved = 0;
+    for (size_t index = 0; index < channel_count_; ++index) {
+        header.entries[index].name_hash = channels_[index].name_hash;
+        header.entries[index].units_per_step = channels_[index].units_per_step;
+        header.entries[index].base_steps = channels_[index].base_steps + static_cast<int64_t>(channels_[index].used_bits);
+    }
+    header.checksum = header_checksum(header);
+
+    return flash_->write(static_cast<size_t>(sector) * SECTOR_SIZE, &header, sizeof(header));
+}
+
+esp_err_t FlashCounterStore::start_fresh_ring_()
+{
+    esp_err_t result = flash_->erase(0, flash_->size());
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    for (size_t index = 0; index < channel_count_; ++index) {
+        channels_[index].base_steps = 0;
+        channels_[index].used_bits = 0;
+    }
+
+    result = write_sector_header_(0, 1);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    active_sector_ = 0;
+    active_sequence_ = 1;
+    return ESP_OK;
+}
+
+// Zalozi nasledujici sektor s aktualnimi hodnotami vsech kanalu. Aktivni
+// sektor zustava platny, dokud neni zapsana nova hlavicka.
+esp_err_t FlashCounterStore::rollover_()
+{
+    const uint32_t next_sector = (active_sector_ + 1) % sector_count_;
+    const uint32_t next_sequence = active_sequence_ + 1;
+
+    esp_err_t result = flash_->erase(static_cast<size_t>(next_sector) * SECTOR_SIZE, SECTOR_SIZE);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    result = write_sector_header_(next_sector, next_sequence);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    for (size_t index = 0; index < channel_count_; ++index) {
+        channels_[index].base_steps += static_cast<int64_t>(channels_[index].used_bits);
+        channels_[index].used_bits = 0;
+    }
+    active_sector_ = next_sector;
+    active_sequence_ = next_sequence;
+    return ESP_OK;
+}
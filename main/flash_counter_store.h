@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_err.h"
+#include "flash_region.h"
+
+// Vice pojmenovanych monotonnich citacu v jedne partition.
+//
+// Stejny princip jako FlashMonotonicCounter (kruh sektoru, krok = vynulovany
+// bit), jen bitova oblast sektoru je rozdelena na stejne velke useky, jeden
+// na kanal. Kazdy kanal ma vlastni velikost kroku v jednotkach; prirustky se
+// hromadi v RAM a flush() je zapise za vsechny kanaly jednim zapisem do flash.
+// Kdyz se kterykoli usek zaplni, zalozi se dalsi sektor s aktualnimi
+// hodnotami vsech kanalu.
+//
+// Kanaly se sparuji podle jmena, takze pridani kanalu zachova hodnoty ostatnich.
+// Neni vlaknove bezpecne - pouziva ho jeden vlastnik.
+class FlashCounterStore {
+public:
+    static constexpr size_t MAX_CHANNELS = 8;
+
+    FlashCounterStore();
+    FlashCounterStore(const FlashCounterStore &) = delete;
+    FlashCounterStore &operator=(const FlashCounterStore &) = delete;
+
+    /**
+     * Prida kanal. Volat pred init().
+     * @param units_per_step kolik jednotek predstavuje jeden zapsany bit
+     */
+    esp_err_t add_channel(const char *name, uint32_t units_per_step, size_t *out_channel);
+
+    esp_err_t init(const char *partition_label);
+    // name slouzi jen pro logy
+    esp_err_t init(FlashRegion &flash, const char *name);
+
+    // Pricte jednotky jen v RAM; do flash je dostane flush()
+    esp_err_t add(size_t channel, uint64_t units);
+
+    // Zapise cele kroky vsech kanalu najednou
+    esp_err_t flush();
+
+    // Hodnota vcetne nezapsanych prirustku
+    uint64_t value(size_t channel) const;
+    // Hodnota, ktera prezije vypadek napajeni
+    uint64_t persisted_value(size_t channel) const;
+
+private:
+    struct Channel {
+        const char *name;
+        uint32_t name_hash;
+        uint32_t units_per_step;
+        int64_t base_steps;      // hodnota na zacatku aktivniho sektoru
+        uint32_t used_bits;      // vynulovane bity v useku aktivniho sektoru
+        uint32_t pending_steps;  // cele kroky cekajici na flush
+        uint32_t residual_units; // zbytek mensi nez krok
+    };
+
+    esp_err_t find_active_sector_(bool *found, bool *layout_matches);
+    esp_err_t load_channels_from_layout_(uint32_t sector);
+    esp_err_t write_sector_header_(uint32_t sector, uint32_t sequence);
+    esp_err_t start_fresh_ring_();
+    esp_err_t rollover_();
+    size_t region_offset_(uint32_t sector, size_t channel, size_t channel_count) const;
+    size_t region_bytes_(size_t channel_count) const;
+
+    PartitionFlashRegion partition_region_;
+    FlashRegion *flash_;
+    std::array<Channel, MAX_CHANNELS> channels_;
+    size_t channel_count_;
+    uint32_t sector_count_;
+    uint32_t active_sector_;
+    uint32_t active_sequence_;
+    bool initialized_;
+};
@@ -1,4 +1,5 @@
 #include "flash_monotonic_counter.h"
+#include "flash_bits.h"
 
 extern "C" {
 #include "nvs.h"
@@ -10,21 +11,25 @@ extern "C" {
 #include <cstdio>
 #include <cstring>
 
+using namespace flash_bits;
+
 namespace {
-constexpr size_t SCAN_CHUNK_SIZE = 256;
 constexpr size_t WRITE_CHUNK_SIZE = 256;
+constexpr size_t SECTOR_HEADER_SIZE = 32;   // zbytek hlavicky do 32 B zustava 0xFF
+constexpr uint32_t SECTOR_MAGIC = 0x52544346; // "FCTR"
 constexpr const char *NVS_NAMESPACE = "flash_ctr";
 constexpr const char *TAG = "FLASH_COUNTER";
 
-uint32_t fnv1a32(const char *text)
+struct SectorHeader {
+    uint32_t magic;
+    uint32_t sequence;
+    int64_t base_value;
+    uint32_t checksum;
+};
+
+uint32_t header_checksum(const SectorHeader &header)
 {
-    uint32_t hash = 2166136261u;
-    while (*text != '\0') {
-        hash ^= static_cast<uint8_t>(*text);
-        hash *= 16777619u;
-        ++text;
-    }
-    return hash;
+    return fnv1a32(&header, offsetof(SectorHeader, checksum));
 }
 }
 
@@ -32,62 +37,97 @@ uint32_t fnv1a32(const char *text)
 #define FLASH_MONOTONIC_COUNTER_VERIFY_WRITES 0
 #endif
 
+// 1 = po binarnim hledani hranice pri init jeste projde cely aktivni sektor
+// a pri neshode pouzije pocet z plneho pruchodu
+#ifndef FLASH_MONOTONIC_COUNTER_VERIFY_SCAN
+#define FLASH_MONOTONIC_COUNTER_VERIFY_SCAN 0
+#endif
+
 FlashMonotonicCounter::FlashMonotonicCounter()
-    : partition_(nullptr),
+    : partition_region_(),
+      flash_(nullptr),
       nvs_base_key_{},
       nvs_pending_key_{},
       base_value_(0),
       used_bits_(0),
       total_bits_(0),
+      sector_count_(0),
+      active_sector_(0),
+      active_sequence_(0),
+      scan_holes_(0),
       initialized_(false)
 {
 }
 
 esp_err_t FlashMonotonicCounter::init(const char *partition_label)
 {
-    if (partition_label == nullptr || partition_label[0] == '\0') {
-        return ESP_ERR_INVALID_ARG;
+    esp_err_t result = partition_region_.open(partition_label);
+    if (result != ESP_OK) {
+        return result;
     }
 
-    partition_ = esp_partition_find_first(
-        ESP_PARTITION_TYPE_DATA,
-        ESP_PARTITION_SUBTYPE_ANY,
-        partition_label);
-    if (partition_ == nullptr) {
-        return ESP_ERR_NOT_FOUND;
-    }
+    return init(partition_region_, partition_label);
+}
 
-    esp_err_t result = derive_nvs_keys_from_partition_label_(partition_label);
-    if (result != ESP_OK) {
-        return result;
+esp_err_t FlashMonotonicCounter::init(FlashRegion &flash, const char *name)
+{
+    if (name == nullptr || name[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    total_bits_ = partition_->size * 8;
+    // Kruh potrebuje aspon dva sektory - jeden drzi hodnotu, druhy se maze
+    if (flash.size() % SECTOR_SIZE != 0 || flash.size() < 2 * SECTOR_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    flash_ = &flash;
+    initialized_ = false;
 
-    result = load_base_from_nvs_();
+    esp_err_t result = derive_nvs_keys_from_partition_label_(name);
     if (result != ESP_OK) {
         return result;
     }
 
-    bool rollover_pending = false;
-    result = load_rollover_pending_from_nvs_(&rollover_pending);
+    sector_count_ = flash.size() / SECTOR_SIZE;
+    total_bits_ = (SECTOR_SIZE - SECTOR_HEADER_SIZE) * 8;
+
+    bool found = false;
+    result = find_active_sector_(&found);
     if (result != ESP_OK) {
         return result;
     }
 
-    if (rollover_pending) {
-        result = esp_partition_erase_range(partition_, 0, partition_->size);
+    if (found) {
+        result = find_used_bits_frontier_();
         if (result != ESP_OK) {
             return result;
         }
 
-        used_bits_ = 0;
-        result = save_rollover_state_to_nvs_(base_value_, false);
+#if FLASH_MONOTONIC_COUNTER_VERIFY_SCAN
+        const uint32_t frontier_bits = used_bits_;
+        result = count_zero_bits_in_sector_();
         if (result != ESP_OK) {
             return result;
         }
+        if (used_bits_ != frontier_bits) {
+            ESP_LOGE(TAG,
+                     "Hranice %lu bitu nesedi s plnym pruchodem %lu bitu",
+                     static_cast<unsigned long>(frontier_bits),
+                     static_cast<unsigned long>(used_bits_));
+        }
+#endif
     } else {
-        result = count_zero_bits_in_partition_();
+        // Zadna platna hlavicka - puvodni format nebo nedokonceny prevod
+        int64_t legacy_value = 0;
+        result = load_legacy_value_(&legacy_value);
+        if (result != ESP_OK) {
+            return result;
+        }
+
+        ESP_LOGW(TAG,
+                 "Prevadim citac %s na kruh sektoru, hodnota=%lld",
+                 name,
+                 static_cast<long long>(legacy_value));
+        result = start_fresh_ring_(legacy_value);
         if (result != ESP_OK) {
             return result;
         }
@@ -158,15 +198,7 @@ esp_err_t FlashMonotonicCounter::reset()
         return ESP_ERR_INVALID_STATE;
     }
 
-    esp_err_t result = esp_partition_erase_range(partition_, 0, partition_->size);
-    if (result != ESP_OK) {
-        return result;
-    }
-
-    base_value_ = 0;
-    used_bits_ = 0;
-
-    return save_rollover_state_to_nvs_(base_value_, false);
+    return start_fresh_ring_(0);
 }
 
 uint64_t FlashMonotonicCounter::value() const
@@ -175,11 +207,132 @@ uint64_t FlashMonotonicCounter::value() const
     return current <= 0 ? 0 : static_cast<uint64_t>(current);
 }
 
+uint64_t FlashMonotonicCounter::sector_erases() const
+{
+    if (!initialized_) {
+        return 0;
+    }
+    return static_cast<uint64_t>(sector_count_) + (active_sequence_ - 1);
+}
+
 int64_t FlashMonotonicCounter::signed_value_() const
 {
     return base_value_ + static_cast<int64_t>(used_bits_);
 }
 
+size_t FlashMonotonicCounter::bits_offset_() const
+{
+    return static_cast<size_t>(active_sector_) * SECTOR_SIZE + SECTOR_HEADER_SIZE;
+}
+
+esp_err_t FlashMonotonicCounter::read_sector_header_(uint32_t sector, bool *valid, uint32_t *sequence, int64_t *base_value) const
+{
+    SectorHeader header = {};
+    esp_err_t result = flash_->read(static_cast<size_t>(sector) * SECTOR_SIZE, &header, sizeof(header));
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    *valid = header.magic == SECTOR_MAGIC && header.checksum == header_checksum(header);
+    *sequence = header.sequence;
+    *base_value = header.base_value;
+    return ESP_OK;
+}
+
+esp_err_t FlashMonotonicCounter::write_sector_header_(uint32_t sector, uint32_t sequence, int64_t base_value)
+{
+    SectorHeader header = {};
+    header.magic = SECTOR_MAGIC;
+    header.sequence = sequence;
+    header.base_value = base_value;
+    header.checksum = header_checksum(header);
+
+    return flash_->write(static_cast<size_t>(sector) * SECTOR_SIZE, &header, sizeof(header));
+}
+
+esp_err_t FlashMonotonicCounter::find_active_sector_(bool *found)
+{
+    *found = false;
+
+    for (uint32_t sector = 0; sector < sector_count_; ++sector) {
+        bool valid = false;
+        uint32_t sequence = 0;
+        int64_t base_value = 0;
+        esp_err_t result = read_sector_header_(sector, &valid, &sequence, &base_value);
+        if (result != ESP_OK) {
+            return result;
+        }
+
+        if (valid && (!*found || sequence_newer(sequence, active_sequence_))) {
+            *found = true;
+            active_sector_ = sector;
+            active_sequence_ = sequence;
+            base_value_ = base_value;
+        }
+    }
+
+    used_bits_ = 0;
+    return ESP_OK;
+}
+
+// Hodnota v puvodnim formatu: zaklad z NVS + vynulovane bity cele partition.
+// Pri nastavenem priznaku rolloveru (vypadek behem mazani) plati jen zaklad.
+esp_err_t FlashMonotonicCounter::load_legacy_value_(int64_t *value)
+{
+    esp_err_t result = load_base_from_nvs_();
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    bool rollover_pending = false;
+    result = load_rollover_pending_from_nvs_(&rollover_pending);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    if (rollover_pending) {
+        *value = base_value_;
+        return ESP_OK;
+    }
+
+    ScanState state;
+    result = scan_region(*flash_, 0, flash_->size(), state);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    *value = base_value_ + static_cast<int64_t>(state.zero_bits);
+    return ESP_OK;
+}
+
+// Smaze vse a zalozi kruh s danou hodnotou. Po dobu mazani drzi hodnotu NVS
+// (stejne jako puvodni rollover), takze vypadek napajeni nic neztrati.
+esp_err_t FlashMonotonicCounter::start_fresh_ring_(int64_t base_value)
+{
+    esp_err_t result = save_rollover_state_to_nvs_(base_value, true);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    result = flash_->erase(0, flash_->size());
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    result = write_sector_header_(0, 1, base_value);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    active_sector_ = 0;
+    active_sequence_ = 1;
+    base_value_ = base_value;
+    used_bits_ = 0;
+    scan_holes_ = 0;
+
+    return save_rollover_state_to_nvs_(base_value, false);
+}
+
 esp_err_t FlashMonotonicCounter::load_base_from_nvs_()
 {
     nvs_handle_t handle = 0;
@@ -253,24 +406,69 @@ esp_err_t FlashMonotonicCounter::save_rollover_state_to_nvs_(int64_t base_value,
     return result;
 }
 
-esp_err_t FlashMonotonicCounter::count_zero_bits_in_partition_()
+// Bity se nuluji striktne poporade (od LSB kazdeho bajtu), takze pouzita
+// oblast sektoru je prefix a hranici staci najit pulenim - pro sektor je to
+// 10 cteni po 4 B a cas roste jen logaritmicky.
+//
+// Zapis preruseny vypadkem napajeni ale muze v rozsahu sveho bufferu
+// vynulovat libovolnou cast bitu. Kdyby se hodnota brala z poctu nul, dalsi
+// kroky by diry preskocily a po dalsim startu by citac couvl. Hodnota proto
+// konci za poslednim vynulovanym bitem v dosahu jednoho zapisu a diry se
+// dopisou, aby prefix zase platil.
+esp_err_t FlashMonotonicCounter::find_used_bits_frontier_()
 {
-    std::array<uint8_t, SCAN_CHUNK_SIZE> buffer = {};
-    used_bits_ = 0;
+    const size_t word_count = (SECTOR_SIZE - SECTOR_HEADER_SIZE) / sizeof(uint32_t);
+    size_t first_word = 0;
+    esp_err_t result = find_prefix_frontier(*flash_, bits_offset_(), word_count, &first_word);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    // Zapis bufferu WRITE_CHUNK_SIZE od nezarovnaneho bitu zasahne o slovo vic
+    std::array<uint32_t, WRITE_CHUNK_SIZE / sizeof(uint32_t) + 1> tail = {};
+    const size_t tail_words = std::min(tail.size(), word_count - first_word);
+    result = flash_->read(bits_offset_() + first_word * sizeof(uint32_t), tail.data(), tail_words * sizeof(uint32_t));
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    ScanState state;
+    scan_words(tail.data(), tail_words, state);
+    const uint32_t prefix_bits = static_cast<uint32_t>(first_word * 32);
+    used_bits_ = prefix_bits + state.used_end;
+    scan_holes_ = state.holes;
+    if (state.holes == 0) {
+        return ESP_OK;
+    }
 
-    size_t offset = 0;
-    while (offset < partition_->size) {
-        const size_t bytes_to_read = std::min<size_t>(buffer.size(), static_cast<size_t>(partition_->size) - offset);
-        esp_err_t result = esp_partition_read(partition_, offset, buffer.data(), bytes_to_read);
+    ESP_LOGW(TAG,
+             "Nedokonceny zapis na hranici (%lu slov), dopisuji do %lu bitu",
+             static_cast<unsigned long>(state.holes),
+             static_cast<unsigned long>(used_bits_));
+    for (uint32_t bit = prefix_bits; bit < used_bits_; bit += WRITE_CHUNK_SIZE * 8) {
+        result = clear_bits_range_(bit, std::min<uint32_t>(used_bits_ - bit, WRITE_CHUNK_SIZE * 8));
         if (result != ESP_OK) {
             return result;
         }
+    }
 
-        for (size_t i = 0; i < bytes_to_read; ++i) {
-            used_bits_ += __builtin_popcount(static_cast<unsigned int>(~buffer[i] & 0xFF));
-        }
+    return ESP_OK;
+}
+
+esp_err_t FlashMonotonicCounter::count_zero_bits_in_sector_()
+{
+    ScanState state;
+    esp_err_t result = scan_region(*flash_, bits_offset_(), SECTOR_SIZE - SECTOR_HEADER_SIZE, state);
+    if (result != ESP_OK) {
+        return result;
+    }
 
-        offset += bytes_to_read;
+    used_bits_ = state.used_end;
+    scan_holes_ = state.holes;
+    if (scan_holes_ != 0) {
+        ESP_LOGE(TAG,
+                 "Vynulovane bity netvori souvisly prefix: %lu poskozenych slov",
+                 static_cast<unsigned long>(scan_holes_));
     }
 
     return ESP_OK;
@@ -290,41 +488,33 @@ esp_err_t FlashMonotonicCounter::clear_bits_range_(uint32_t start_bit, uint32_t
     const uint32_t end_bit = start_bit + bit_count;
     const uint32_t end_byte = (end_bit + 7) / 8;
     const uint32_t bytes_to_write = end_byte - start_byte;
+    const size_t offset = bits_offset_() + start_byte;
 
     std::array<uint8_t, WRITE_CHUNK_SIZE> buffer = {};
     if (bytes_to_write > buffer.size()) {
         return ESP_ERR_INVALID_SIZE;
     }
 
-    esp_err_t read_result = esp_partition_read(partition_, start_byte, buffer.data(), bytes_to_write);
+    esp_err_t read_result = flash_->read(offset, buffer.data(), bytes_to_write);
     if (read_result != ESP_OK) {
         return read_result;
     }
 
-    for (uint32_t byte_offset = 0; byte_offset < bytes_to_write; ++byte_offset) {
-        const uint32_t abs_byte = start_byte + byte_offset;
-        const uint32_t byte_first_bit = abs_byte * 8;
-        const uint32_t clear_from = std::max(start_bit, byte_first_bit);
-        const uint32_t clear_to = std::min(end_bit, byte_first_bit + 8);
-
-        for (uint32_t bit = clear_from; bit < clear_to; ++bit) {
-            buffer[byte_offset] = static_cast<uint8_t>(buffer[byte_offset] & ~(1U << (bit - byte_first_bit)));
-        }
-    }
+    clear_bits(buffer.data(), start_bit - start_byte * 8, bit_count);
 
-    esp_err_t write_result = esp_partition_write(partition_, start_byte, buffer.data(), bytes_to_write);
+    esp_err_t write_result = flash_->write(offset, buffer.data(), bytes_to_write);
     if (write_result != ESP_OK) {
         return write_result;
     }
 
 #if FLASH_MONOTONIC_COUNTER_VERIFY_WRITES
-    return verify_written_bytes_(start_byte, buffer.data(), bytes_to_write);
+    return verify_written_bytes_(offset, buffer.data(), bytes_to_write);
 #else
     return ESP_OK;
 #endif
 }
 
-esp_err_t FlashMonotonicCounter::verify_written_bytes_(uint32_t start_byte, const uint8_t *expected, uint32_t bytes_to_check)
+esp_err_t FlashMonotonicCounter::verify_written_bytes_(size_t offset, const uint8_t *expected, uint32_t bytes_to_check)
 {
     if (expected == nullptr || bytes_to_check == 0) {
         return ESP_ERR_INVALID_ARG;
@@ -335,7 +525,7 @@ esp_err_t FlashMonotonicCounter::verify_written_bytes_(uint32_t start_byte, cons
         return ESP_ERR_INVALID_SIZE;
     }
 
-    esp_err_t read_result = esp_partition_read(partition_, start_byte, verify_buffer.data(), bytes_to_check);
+    esp_err_t read_result = flash_->read(offset, verify_buffer.data(), bytes_to_check);
     if (read_result != ESP_OK) {
         return read_result;
     }
@@ -350,8 +540,8 @@ esp_err_t FlashMonotonicCounter::verify_written_bytes_(uint32_t start_byte, cons
         const uint8_t actual_value = verify_buffer[mismatch_offset];
         ESP_LOGE(
             TAG,
-            "Verify mismatch: start_byte=%lu bytes=%lu mismatch_offset=%lu expected=0x%02x actual=0x%02x",
-            static_cast<unsigned long>(start_byte),
+            "Verify mismatch: offset=%lu bytes=%lu mismatch_offset=%lu expected=0x%02x actual=0x%02x",
+            static_cast<unsigned long>(offset),
             static_cast<unsigned long>(bytes_to_check),
             static_cast<unsigned long>(mismatch_offset),
             expected_value,
@@ -362,27 +552,30 @@ esp_err_t FlashMonotonicCounter::verify_written_bytes_(uint32_t start_byte, cons
     return ESP_OK;
 }
 
+// Zalozi nasledujici sektor kruhu. Plny aktivni sektor zustava nedotcen, dokud
+// nova hlavicka neni zapsana - vypadek napajeni kdykoli behem mazani nebo
+// zapisu hlavicky tedy jen zpusobi, ze se rollover zopakuje pri dalsim kroku.
 esp_err_t FlashMonotonicCounter::rollover_()
 {
+    const uint32_t next_sector = (active_sector_ + 1) % sector_count_;
+    const uint32_t next_sequence = active_sequence_ + 1;
     const int64_t new_base = signed_value_();
 
-    esp_err_t result = save_rollover_state_to_nvs_(new_base, true);
+    esp_err_t result = flash_->erase(static_cast<size_t>(next_sector) * SECTOR_SIZE, SECTOR_SIZE);
     if (result != ESP_OK) {
         return result;
     }
 
-    result = esp_partition_erase_range(partition_, 0, partition_->size);
+    result = write_sector_header_(next_sector, next_sequence, new_base);
     if (result != ESP_OK) {
         return result;
     }
 
+    active_sector_ = next_sector;
+    active_sequence_ = next_sequence;
     base_value_ = new_base;
     used_bits_ = 0;
-
-    result = save_rollover_state_to_nvs_(base_value_, false);
-    if (result != ESP_OK) {
-        return result;
-    }
+    scan_holes_ = 0;
 
     return ESP_OK;
 }
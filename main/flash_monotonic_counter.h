@@ -1,38 +1,77 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
 #include "esp_err.h"
-#include "esp_partition.h"
+#include "flash_region.h"
 
+// Monotonni citac v NOR flash: kazdy krok vynuluje dalsi bit.
+//
+// Partition je kruh sektoru. Kazdy sektor zacina hlavickou s poradovym
+// cislem a hodnotou citace na zacatku sektoru, za ni jsou bity krok po kroku.
+// Aktivni je platny sektor s nejvyssim poradovym cislem. Kdyz se zaplni,
+// smaze se nasledujici sektor v kruhu a zapise se do nej nova hlavicka -
+// stary sektor drzi hodnotu az do te chvile, takze rollover je odolny proti
+// vypadku napajeni a nepotrebuje NVS. Mazani se rovnomerne stridaji.
+//
+// NVS se pouziva jen pro prevod z puvodniho formatu (cela partition jako
+// bity, zaklad a priznak rolloveru v NVS) a pro reset().
 class FlashMonotonicCounter {
 public:
     FlashMonotonicCounter();
+    FlashMonotonicCounter(const FlashMonotonicCounter &) = delete;
+    FlashMonotonicCounter &operator=(const FlashMonotonicCounter &) = delete;
 
     esp_err_t init(const char *partition_label);
+    // name slouzi pro klice NVS (prevod z puvodniho formatu) a logy
+    esp_err_t init(FlashRegion &flash, const char *name);
     esp_err_t increment(uint32_t steps = 1);
     esp_err_t reset();
 
     uint64_t value() const;
 
+    // Pocet slov, ktera pri poslednim pruchodu porusila souvisly prefix
+    // vynulovanych bitu (nenulove = zapis preruseny vypadkem nebo poskozena flash)
+    uint32_t scan_holes() const { return scan_holes_; }
+
+    // Pro odhad opotrebeni flash
+    uint32_t sector_count() const { return sector_count_; }
+    uint32_t bits_per_sector() const { return total_bits_; }
+    // Mazani sektoru od zalozeni kruhu (kazdy sektor jednou + jeden za kazdy
+    // rollover); starsi historie pred reset() nebo prevodem se nepocita
+    uint64_t sector_erases() const;
+
 private:
     esp_err_t derive_nvs_keys_from_partition_label_(const char *partition_label);
     esp_err_t load_base_from_nvs_();
     esp_err_t load_rollover_pending_from_nvs_(bool *pending);
     esp_err_t save_rollover_state_to_nvs_(int64_t base_value, bool pending) const;
     int64_t signed_value_() const;
-    esp_err_t count_zero_bits_in_partition_();
+    esp_err_t find_active_sector_(bool *found);
+    esp_err_t read_sector_header_(uint32_t sector, bool *valid, uint32_t *sequence, int64_t *base_value) const;
+    esp_err_t write_sector_header_(uint32_t sector, uint32_t sequence, int64_t base_value);
+    esp_err_t load_legacy_value_(int64_t *value);
+    esp_err_t start_fresh_ring_(int64_t base_value);
+    esp_err_t find_used_bits_frontier_();
+    esp_err_t count_zero_bits_in_sector_();
     esp_err_t clear_bits_range_(uint32_t start_bit, uint32_t bit_count);
-    esp_err_t verify_written_bytes_(uint32_t start_byte, const uint8_t *expected, uint32_t bytes_to_check);
+    esp_err_t verify_written_bytes_(size_t offset, const uint8_t *expected, uint32_t bytes_to_check);
     esp_err_t rollover_();
+    size_t bits_offset_() const;
 
-    const esp_partition_t *partition_;
+    PartitionFlashRegion partition_region_;
+    FlashRegion *flash_;
     std::array<char, 16> nvs_base_key_;
     std::array<char, 16> nvs_pending_key_;
 
-    int64_t base_value_;
-    uint32_t used_bits_;
-    uint32_t total_bits_;
+    int64_t base_value_;       // hodnota na zacatku aktivniho sektoru
+    uint32_t used_bits_;       // vynulovane bity v aktivnim sektoru
+    uint32_t total_bits_;      // bitu na sektor
+    uint32_t sector_count_;
+    uint32_t active_sector_;
+    uint32_t active_sequence_;
+    uint32_t scan_holes_;
     bool initialized_;
 };
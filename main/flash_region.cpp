@@ -0,0 +1,49 @@
+#include "flash_region.h"
+
+esp_err_t PartitionFlashRegion::open(const char *partition_label)
+{
+    if (partition_label == nullptr || partition_label[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    partition_ = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA,
+        ESP_PARTITION_SUBTYPE_ANY,
+        partition_label);
+    return partition_ == nullptr ? ESP_ERR_NOT_FOUND : ESP_OK;
+}
+
+size_t PartitionFlashRegion::size() const
+{
+    return partition_ == nullptr ? 0 : partition_->size;
+}
+
+esp_err_t PartitionFlashRegion::read(size_t offset, void *data, size_t length)
+{
+    return esp_partition_read(partition_, offset, data, length);
+}
+
+esp_err_t PartitionFlashRegion::write(size_t offset, const void *data, size_t length)
+{
+    return esp_partition_write(partition_, offset, data, length);
+}
+
+esp_err_t PartitionFlashRegion::erase(size_t offset, size_t length)
+{
+    return esp_partition_erase_range(partition_, offset, length);
+}
+
+esp_err_t PartitionFlashRegion::map(size_t offset, size_t length, const void **data, uint32_t *handle)
+{
+    esp_partition_mmap_handle_t mmap_handle = 0;
+    esp_err_t result = esp_partition_mmap(partition_, offset, length, ESP_PARTITION_MMAP_DATA, data, &mmap_handle);
+    if (result == ESP_OK) {
+        *handle = static_cast<uint32_t>(mmap_handle);
+    }
+    return result;
+}
+
+void PartitionFlashRegion::unmap(uint32_t handle)
+{
+    esp_partition_munmap(static_cast<esp_partition_mmap_handle_t>(handle));
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_err.h"
+#include "esp_partition.h"
+
+// Oblast NOR flash, nad kterou pracuji citace (FlashMonotonicCounter,
+// FlashCounterStore). Citace nevolaji esp_partition_* primo, takze je lze
+// prelozit i proti emulaci flash (hostitelsky build, vypadky napajeni).
+//
+// Pravidla NOR, na ktera citace spoleha: zapis jen nuluje bity, jednicky
+// vraci jen mazani a to po celych sektorech (4 KB).
+class FlashRegion {
+public:
+    virtual ~FlashRegion() = default;
+
+    virtual size_t size() const = 0;
+    virtual esp_err_t read(size_t offset, void *data, size_t length) = 0;
+    virtual esp_err_t write(size_t offset, const void *data, size_t length) = 0;
+    virtual esp_err_t erase(size_t offset, size_t length) = 0;
+
+    // Primy ukazatel na obsah pro rychle cteni; bez podpory vraci
+    // ESP_ERR_NOT_SUPPORTED a citac cte pres read()
+    virtual esp_err_t map(size_t offset, size_t length, const void **data, uint32_t *handle)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    virtual void unmap(uint32_t handle) {}
+};
+
+// Oblast nad partition z partition table
+class PartitionFlashRegion : public FlashRegion {
+public:
+    PartitionFlashRegion() : partition_(nullptr) {}
+
+    esp_err_t open(const char *partition_label);
+
+    size_t size() const override;
+    esp_err_t read(size_t offset, void *data, size_t length) override;
+    esp_err_t write(size_t offset, const void *data, size_t length) override;
+    esp_err_t erase(size_t offset, size_t length) override;
+    esp_err_t map(size_t offset, size_t length, const void **data, uint32_t *handle) override;
+    void unmap(uint32_t handle) override;
+
+private:
+    const esp_partition_t *partition_;
+};
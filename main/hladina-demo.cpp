@@ -1,3 +1,10 @@
+// 1 = ADC v kontinualnim rezimu s DMA: vzorky po celych ramcich, do filtru jde
+//     prumer pres celou periodu site (potlaci brum)
+// 0 = jeden oneshot vzorek na kazde spusteni ulohy (puvodni reseni)
+#ifndef HLADINA_USE_ADC_CONTINUOUS
+#define HLADINA_USE_ADC_CONTINUOUS 1
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -6,16 +13,29 @@ extern "C" {
 #include <freertos/task.h>
 #include <esp_log.h>
 #include <esp_timer.h>
+#include <esp_attr.h>
+#if HLADINA_USE_ADC_CONTINUOUS
+#include <esp_adc/adc_continuous.h>
+#else
 #include <esp_adc/adc_oneshot.h>
+#endif
+#include <esp_adc/adc_cali.h>
+#include <esp_adc/adc_cali_scheme.h>
 #include <driver/gpio.h>
 
 #ifdef __cplusplus
 }
 #endif
 
+#include <atomic>
+#include <math.h>
+
 #include "trimmed_mean.hpp"
+#include "piecewise_linear.hpp"
 #include "config_webapp.h"
 #include "sensor_events.h"
+#include "tick_scheduler.h"
+#include "tank_geometry.h"
 
 #define TAG "LEVEL_DEMO"
 
@@ -28,6 +48,21 @@ extern "C" {
 static const adc_channel_t LEVEL_ADC_CHANNEL = ADC_CHANNEL_6;
 static const adc_unit_t LEVEL_ADC_UNIT = ADC_UNIT_1;
 
+// Rozsah pri utlumu 12 dB, pokud cip nema kalibraci v eFuse
+static const int LEVEL_ADC_NOMINAL_FULL_SCALE_MV = 3100;
+
+#if HLADINA_USE_ADC_CONTINUOUS
+static const int32_t LEVEL_ADC_DEFAULT_SAMPLE_HZ = 20000;
+static const int32_t LEVEL_DEFAULT_MAINS_HZ = 50;
+// Perioda vybírání hotových rámců z DMA; zásobník pojme ~200 ms vzorků při 20 kHz
+static const int32_t LEVEL_DEFAULT_SAMPLE_PERIOD_MS = 100;
+static const int32_t LEVEL_MAX_SAMPLE_PERIOD_MS = 150;
+#else
+// Perioda vzorkování ADC (dříve 10 ms pauza ve čtení + 20 ms ve smyčce)
+static const int32_t LEVEL_DEFAULT_SAMPLE_PERIOD_MS = 30;
+static const int32_t LEVEL_MAX_SAMPLE_PERIOD_MS = 1000;
+#endif
+
 static const config_item_t LEVEL_CONFIG_ITEMS[] = {
     {
         .key = "lvl_raw_min",
@@ -89,6 +124,191 @@ static const config_item_t LEVEL_CONFIG_ITEMS[] = {
         .min_float = 0.0f,
         .max_float = 5.0f,
     },
+    {
+        .key = "lvl_cal_table",
+        .label = "Hladina kalibrace mV:m",
+        .description = "Body napeti_mV:vyska_m oddelene carkou s rostoucim napetim, napr. 150:0,900:0.5,2450:1.8 "
+                       "(2 az 16 bodu). Prazdne = linearne podle RAW min/max.",
+        .type = CONFIG_VALUE_STRING,
+        .default_string = "",
+        .default_int = 0,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 255,
+        .min_int = 0,
+        .max_int = 0,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+    {
+        .key = "lvl_deadband_m",
+        .label = "Hladina pasmo necitlivosti [m]",
+        .description = "Nova hladina se posle, az se od posledni poslane zmeni aspon o tolik.",
+        .type = CONFIG_VALUE_FLOAT,
+        .default_string = nullptr,
+        .default_int = 0,
+        .default_float = 0.002f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 0,
+        .max_int = 0,
+        .min_float = 0.0f,
+        .max_float = 0.5f,
+    },
+    {
+        .key = "lvl_silence_s",
+        .label = "Hladina max. ticho [s]",
+        .description = "I beze zmeny se hladina posle nejpozdeji po teto dobe.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = 60,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 1,
+        .max_int = 3600,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+    {
+        .key = "tank_shape",
+        .label = "Tvar nadrze",
+        .description = "0 = svisle steny (plocha dna), 1 = lezaty valec, 2 = tabulka vyska:litry.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = 0,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 0,
+        .max_int = 2,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+    {
+        .key = "tank_h_m",
+        .label = "Nadrz vyska [m]",
+        .description = "Svisle steny: vyska nadrze.",
+        .type = CONFIG_VALUE_FLOAT,
+        .default_string = nullptr,
+        .default_int = 0,
+        .default_float = 1.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 0,
+        .max_int = 0,
+        .min_float = 0.01f,
+        .max_float = 10.0f,
+    },
+    {
+        .key = "tank_area_m2",
+        .label = "Nadrz plocha dna [m2]",
+        .description = "Svisle steny: vnitrni plocha dna.",
+        .type = CONFIG_VALUE_FLOAT,
+        .default_string = nullptr,
+        .default_int = 0,
+        .default_float = 1.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 0,
+        .max_int = 0,
+        .min_float = 0.001f,
+        .max_float = 100.0f,
+    },
+    {
+        .key = "tank_diam_m",
+        .label = "Nadrz prumer [m]",
+        .description = "Lezaty valec: vnitrni prumer.",
+        .type = CONFIG_VALUE_FLOAT,
+        .default_string = nullptr,
+        .default_int = 0,
+        .default_float = 1.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 0,
+        .max_int = 0,
+        .min_float = 0.01f,
+        .max_float = 10.0f,
+    },
+    {
+        .key = "tank_len_m",
+        .label = "Nadrz delka [m]",
+        .description = "Lezaty valec: vnitrni delka.",
+        .type = CONFIG_VALUE_FLOAT,
+        .default_string = nullptr,
+        .default_int = 0,
+        .default_float = 2.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 0,
+        .max_int = 0,
+        .min_float = 0.01f,
+        .max_float = 50.0f,
+    },
+    {
+        .key = "tank_table",
+        .label = "Nadrz tabulka",
+        .description = "Tabulka: body vyska_m:litry oddelene carkou s rostouci vyskou, napr. 0:0,0.1:60,1.0:1000.",
+        .type = CONFIG_VALUE_STRING,
+        .default_string = "0:0,1:1000",
+        .default_int = 0,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 255,
+        .min_int = 0,
+        .max_int = 0,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+    {
+        .key = "lvl_sample_ms",
+        .label = "Hladina perioda vzorkovani [ms]",
+        .description = "Jak casto uloha vycita ADC. V kontinualnim rezimu nejvys 150 ms, "
+                       "jinak pretece zasobnik DMA.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = LEVEL_DEFAULT_SAMPLE_PERIOD_MS,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 10,
+        .max_int = LEVEL_MAX_SAMPLE_PERIOD_MS,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+#if HLADINA_USE_ADC_CONTINUOUS
+    {
+        .key = "lvl_adc_hz",
+        .label = "Hladina vzorkovani ADC [Hz]",
+        .description = "Vzorkovaci frekvence ADC v kontinualnim rezimu. Spodni mez je minimum "
+                       "cipu (ESP32 umi nejmene 20 kHz), horni dana velikosti zasobniku DMA.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = LEVEL_ADC_DEFAULT_SAMPLE_HZ,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = SOC_ADC_SAMPLE_FREQ_THRES_LOW,
+        .max_int = LEVEL_ADC_DEFAULT_SAMPLE_HZ,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+    {
+        .key = "lvl_mains_hz",
+        .label = "Frekvence site [Hz]",
+        .description = "Vzorky se prumeruji pres celou periodu site, aby se potlacil brum.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = LEVEL_DEFAULT_MAINS_HZ,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 45,
+        .max_int = 65,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+#endif
 };
 
 typedef struct {
@@ -96,6 +316,13 @@ typedef struct {
     int32_t adc_raw_max;
     float height_min;
     float height_max;
+    float deadband_m;
+    int32_t max_silence_s;
+    int32_t sample_period_ms;
+#if HLADINA_USE_ADC_CONTINUOUS
+    int32_t adc_sample_hz;
+    int32_t mains_hz;
+#endif
 } level_calibration_config_t;
 
 static level_calibration_config_t g_level_config = {
@@ -103,12 +330,98 @@ static level_calibration_config_t g_level_config = {
     .adc_raw_max = 950,
     .height_min = 0.0f,
     .height_max = 0.290f,
+    .deadband_m = 0.002f,
+    .max_silence_s = 60,
+    .sample_period_ms = LEVEL_DEFAULT_SAMPLE_PERIOD_MS,
+#if HLADINA_USE_ADC_CONTINUOUS
+    .adc_sample_hz = LEVEL_ADC_DEFAULT_SAMPLE_HZ,
+    .mains_hz = LEVEL_DEFAULT_MAINS_HZ,
+#endif
 };
 
+#if HLADINA_USE_ADC_CONTINUOUS
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define LEVEL_ADC_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define LEVEL_ADC_GET_CHANNEL(p) ((p)->type1.channel)
+#define LEVEL_ADC_GET_DATA(p) ((p)->type1.data)
+#else
+#define LEVEL_ADC_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define LEVEL_ADC_GET_CHANNEL(p) ((p)->type2.channel)
+#define LEVEL_ADC_GET_DATA(p) ((p)->type2.data)
+#endif
+
+// Ramec DMA a kolik ramcu se vejde do zasobniku mezi dvema spustenimi ulohy
+// (100 ms pri 20 kHz = 2000 vzorku = 8 ramcu, zasobnik ma rezervu 2x)
+static const uint32_t LEVEL_ADC_FRAME_SAMPLES = 256;
+static const uint32_t LEVEL_ADC_FRAME_BYTES = LEVEL_ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES;
+static const uint32_t LEVEL_ADC_POOL_FRAMES = 16;
+// Průměry period sítě se do filtru vkládají po blocích nejvýš této délky
+static const size_t LEVEL_MEANS_BATCH = 32;
+
+static adc_continuous_handle_t adc_handle = NULL;
+static uint8_t s_adc_frame[LEVEL_ADC_FRAME_BYTES];
+
+// Prumerovani pres periodu site
+static uint32_t s_block_samples = 0;
+static uint32_t s_block_count = 0;
+static uint32_t s_block_sum = 0;
+
+// Zahozena data pri plnem zasobniku DMA (uloha nestiha cist)
+static std::atomic<uint32_t> s_pool_overflows{0};
+static uint32_t s_reported_pool_overflows = 0;
+
+#else
 static adc_oneshot_unit_handle_t adc_handle = NULL;
+#endif
 
-// Vytvoříme instanci filtrů pro měření hladiny (31 prvků, 5 oříznutých z obou stran)
-static TrimmedMean<31, 5> level_filter;
+// Charakteristika ADC z eFuse (NULL = jen jmenovity rozsah)
+static adc_cali_handle_t s_adc_cali = NULL;
+
+// Kalibrace napětí -> výška; bez bodů platí lineární převod z RAW min/max
+static PiecewiseLinear<16> s_height_calibration;
+
+// Vytvoříme instanci filtrů pro měření hladiny (31 prvků, 5 oříznutých z obou stran,
+// 12bitové RAW hodnoty)
+static TrimmedMean<31, 5, uint16_t> level_filter;
+
+// Tvar nádrže pro převod výšky na objem
+static tank_geometry_config_t g_tank_config = {
+    .shape = TANK_SHAPE_PRISM,
+    .height_m = 1.0f,
+    .area_m2 = 1.0f,
+    .diameter_m = 1.0f,
+    .length_m = 2.0f,
+    .table = nullptr,
+};
+static char s_tank_table[256];
+
+// Kolik vzorků ještě zbývá do nabití filtru
+static size_t s_priming_samples_left = 0;
+
+// Poslední odeslaná hladina - další se posílá až po změně o deadband_m
+// nebo po max_silence_s
+static bool s_level_published = false;
+static float s_published_height_m = 0.0f;
+static int64_t s_published_at_us = 0;
+
+static void load_tank_geometry_config(void)
+{
+    int32_t shape = TANK_SHAPE_PRISM;
+    ESP_ERROR_CHECK(config_webapp_get_i32("tank_shape", &shape));
+    ESP_ERROR_CHECK(config_webapp_get_float("tank_h_m", &g_tank_config.height_m));
+    ESP_ERROR_CHECK(config_webapp_get_float("tank_area_m2", &g_tank_config.area_m2));
+    ESP_ERROR_CHECK(config_webapp_get_float("tank_diam_m", &g_tank_config.diameter_m));
+    ESP_ERROR_CHECK(config_webapp_get_float("tank_len_m", &g_tank_config.length_m));
+    ESP_ERROR_CHECK(config_webapp_get_string("tank_table", s_tank_table, sizeof(s_tank_table)));
+    g_tank_config.shape = (tank_shape_t)shape;
+    g_tank_config.table = s_tank_table;
+
+    const esp_err_t result = tank_geometry_build(&g_tank_config);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Neplatny tvar nadrze (%s), objem nebude k dispozici", esp_err_to_name(result));
+    }
+}
 
 static void load_level_calibration_config(void)
 {
@@ -116,15 +429,174 @@ static void load_level_calibration_config(void)
     ESP_ERROR_CHECK(config_webapp_get_i32("lvl_raw_max", &g_level_config.adc_raw_max));
     ESP_ERROR_CHECK(config_webapp_get_float("lvl_h_min", &g_level_config.height_min));
     ESP_ERROR_CHECK(config_webapp_get_float("lvl_h_max", &g_level_config.height_max));
+    ESP_ERROR_CHECK(config_webapp_get_float("lvl_deadband_m", &g_level_config.deadband_m));
+    ESP_ERROR_CHECK(config_webapp_get_i32("lvl_silence_s", &g_level_config.max_silence_s));
+    ESP_ERROR_CHECK(config_webapp_get_i32("lvl_sample_ms", &g_level_config.sample_period_ms));
+    if (g_level_config.sample_period_ms <= 0 || g_level_config.sample_period_ms > LEVEL_MAX_SAMPLE_PERIOD_MS) {
+        g_level_config.sample_period_ms = LEVEL_DEFAULT_SAMPLE_PERIOD_MS;
+    }
+#if HLADINA_USE_ADC_CONTINUOUS
+    ESP_ERROR_CHECK(config_webapp_get_i32("lvl_adc_hz", &g_level_config.adc_sample_hz));
+    ESP_ERROR_CHECK(config_webapp_get_i32("lvl_mains_hz", &g_level_config.mains_hz));
+#endif
+
+    char table[256];
+    ESP_ERROR_CHECK(config_webapp_get_string("lvl_cal_table", table, sizeof(table)));
+    if (table[0] != '\0' && !s_height_calibration.parse(table)) {
+        ESP_LOGE(TAG, "Neplatna kalibracni tabulka hladiny, pouzivam RAW min/max");
+    }
 
     ESP_LOGI(TAG,
-             "Nactena kalibrace hladiny: raw_min=%ld raw_max=%ld h_min=%.3f m h_max=%.3f m",
+             "Nactena kalibrace hladiny: raw_min=%ld raw_max=%ld h_min=%.3f m h_max=%.3f m, "
+             "pasmo %.4f m, ticho max %ld s, perioda %ld ms, kalibracnich bodu %zu",
              (long)g_level_config.adc_raw_min,
              (long)g_level_config.adc_raw_max,
              g_level_config.height_min,
-             g_level_config.height_max);
+             g_level_config.height_max,
+             g_level_config.deadband_m,
+             (long)g_level_config.max_silence_s,
+             (long)g_level_config.sample_period_ms,
+             s_height_calibration.getCount());
+}
+
+// Vloží hodnoty do filtru a odpočítá nabíjení bufferu
+static void level_filter_insert(const uint16_t *values, size_t count)
+{
+    level_filter.insertBulk(values, count);
+    if (s_priming_samples_left > 0) {
+        s_priming_samples_left = count < s_priming_samples_left ? s_priming_samples_left - count : 0;
+        if (s_priming_samples_left == 0) {
+            ESP_LOGI(TAG, "Buffer nabití, začínáme publikovat výsledky");
+        }
+    }
+}
+
+#if HLADINA_USE_ADC_CONTINUOUS
+
+static bool IRAM_ATTR adc_on_pool_ovf(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    s_pool_overflows.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+/**
+ * Inicializuje ADC v kontinuálním režimu s DMA pro čtení senzoru hladiny
+ */
+static esp_err_t adc_init(void)
+{
+    // Konfigurace meze hlida, tohle zachyti jen hodnoty ulozene pred jejich zmenou
+    int32_t sample_hz = g_level_config.adc_sample_hz;
+    if (sample_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW) {
+        ESP_LOGW(TAG, "Vzorkovani %ld Hz je pod minimem cipu, pouzivam %d Hz",
+                 (long)sample_hz, SOC_ADC_SAMPLE_FREQ_THRES_LOW);
+        sample_hz = SOC_ADC_SAMPLE_FREQ_THRES_LOW;
+    } else if (sample_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) {
+        sample_hz = SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+    }
+    const int32_t mains_hz = g_level_config.mains_hz > 0 ? g_level_config.mains_hz : LEVEL_DEFAULT_MAINS_HZ;
+    s_block_samples = (uint32_t)((sample_hz + mains_hz / 2) / mains_hz);
+
+    adc_continuous_handle_cfg_t handle_config;
+    memset(&handle_config, 0, sizeof(handle_config));
+    handle_config.max_store_buf_size = LEVEL_ADC_POOL_FRAMES * LEVEL_ADC_FRAME_BYTES;
+    handle_config.conv_frame_size = LEVEL_ADC_FRAME_BYTES;
+    handle_config.flags.flush_pool = 1;
+
+    if (adc_continuous_new_handle(&handle_config, &adc_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Chyba: Nelze inicializovat ADC v kontinuálním režimu");
+        return ESP_FAIL;
+    }
+
+    adc_digi_pattern_config_t pattern;
+    memset(&pattern, 0, sizeof(pattern));
+    pattern.atten = ADC_ATTEN_DB_12;
+    pattern.channel = LEVEL_ADC_CHANNEL;
+    pattern.unit = LEVEL_ADC_UNIT;
+    pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+    adc_continuous_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.pattern_num = 1;
+    config.adc_pattern = &pattern;
+    config.sample_freq_hz = (uint32_t)sample_hz;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = LEVEL_ADC_OUTPUT_FORMAT;
+
+    if (adc_continuous_config(adc_handle, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Chyba: Nelze nakonfigurovat ADC kanál");
+        return ESP_FAIL;
+    }
+
+    adc_continuous_evt_cbs_t callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.on_pool_ovf = adc_on_pool_ovf;
+    if (adc_continuous_register_event_callbacks(adc_handle, &callbacks, NULL) != ESP_OK
+        || adc_continuous_start(adc_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Chyba: Nelze spustit ADC");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "ADC kontinuálně %ld Hz, průměr přes %lu vzorků (%ld Hz síť)",
+             (long)sample_hz, (unsigned long)s_block_samples, (long)mains_hz);
+    return ESP_OK;
 }
 
+/**
+ * Vybere z DMA všechny hotové rámce a po celých periodách sítě vkládá
+ * průměry do filtru. Průměr přes celou periodu potlačí brum ze sítě.
+ * @return počet hodnot vložených do filtru
+ */
+static uint32_t adc_read_samples(void)
+{
+    uint16_t means[LEVEL_MEANS_BATCH];
+    size_t mean_count = 0;
+    uint32_t inserted = 0;
+    while (true) {
+        uint32_t length = 0;
+        const esp_err_t result = adc_continuous_read(adc_handle, s_adc_frame, sizeof(s_adc_frame), &length, 0);
+        if (result == ESP_ERR_TIMEOUT) {
+            break; // žádný další hotový rámec
+        }
+        if (result != ESP_OK) {
+            ESP_LOGE(TAG, "Chyba při čtení ADC: %s", esp_err_to_name(result));
+            break;
+        }
+
+        for (uint32_t offset = 0; offset + SOC_ADC_DIGI_RESULT_BYTES <= length; offset += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t *sample = reinterpret_cast<const adc_digi_output_data_t *>(&s_adc_frame[offset]);
+            if (LEVEL_ADC_GET_CHANNEL(sample) != LEVEL_ADC_CHANNEL) {
+                continue;
+            }
+
+            s_block_sum += LEVEL_ADC_GET_DATA(sample);
+            if (++s_block_count == s_block_samples) {
+                means[mean_count++] = (uint16_t)((s_block_sum + s_block_samples / 2) / s_block_samples);
+                s_block_sum = 0;
+                s_block_count = 0;
+                if (mean_count == LEVEL_MEANS_BATCH) {
+                    level_filter_insert(means, mean_count);
+                    inserted += mean_count;
+                    mean_count = 0;
+                }
+            }
+        }
+    }
+    if (mean_count > 0) {
+        level_filter_insert(means, mean_count);
+        inserted += mean_count;
+    }
+
+    const uint32_t overflows = s_pool_overflows.load(std::memory_order_relaxed);
+    if (overflows != s_reported_pool_overflows) {
+        ESP_LOGW(TAG, "Zasobnik DMA pretekl %lu x, cast vzorku zahozena",
+                 (unsigned long)(overflows - s_reported_pool_overflows));
+        s_reported_pool_overflows = overflows;
+    }
+    return inserted;
+}
+
+#else
+
 /**
  * Inicializuje ADC pro čtení senzoru hladiny
  */
@@ -153,10 +625,10 @@ static esp_err_t adc_init(void)
 }
 
 /**
- * Čte průměrnou hodnotu z ADC
- * @return průměrná RAW hodnota ADC po oříznutí extrémů
+ * Přečte jeden vzorek z ADC a vloží ho do filtru
+ * @return počet hodnot vložených do filtru
  */
-static uint32_t adc_read_average(void)
+static uint32_t adc_read_samples(void)
 {
     int raw_value = 0;  
     if (adc_oneshot_read(adc_handle, LEVEL_ADC_CHANNEL, &raw_value) != ESP_OK) {
@@ -165,10 +637,66 @@ static uint32_t adc_read_average(void)
     }
     
     // Vložíme hodnotu do filtru
-    level_filter.insert(raw_value);
-    vTaskDelay(pdMS_TO_TICKS(10));  // Krátká pauza mezi vzorky
-    
-    return level_filter.getValue();
+    const uint16_t value = (uint16_t)raw_value;
+    level_filter_insert(&value, 1);
+    return 1;
+}
+
+#endif
+
+/**
+ * Připraví převod RAW -> mV z kalibrace uložené v eFuse. ESP32 umí jen
+ * proložení přímkou, novější čipy křivku.
+ */
+static void adc_calibration_init(void)
+{
+    esp_err_t result = ESP_ERR_NOT_SUPPORTED;
+    const char *scheme = "zadne";
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t curve_config;
+    memset(&curve_config, 0, sizeof(curve_config));
+    curve_config.unit_id = LEVEL_ADC_UNIT;
+    curve_config.chan = LEVEL_ADC_CHANNEL;
+    curve_config.atten = ADC_ATTEN_DB_12;
+    curve_config.bitwidth = ADC_BITWIDTH_DEFAULT;
+    result = adc_cali_create_scheme_curve_fitting(&curve_config, &s_adc_cali);
+    scheme = "krivka";
+#endif
+
+#if ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    if (result != ESP_OK) {
+        adc_cali_line_fitting_config_t line_config;
+        memset(&line_config, 0, sizeof(line_config));
+        line_config.unit_id = LEVEL_ADC_UNIT;
+        line_config.atten = ADC_ATTEN_DB_12;
+        line_config.bitwidth = ADC_BITWIDTH_DEFAULT;
+        result = adc_cali_create_scheme_line_fitting(&line_config, &s_adc_cali);
+        scheme = "primka";
+    }
+#endif
+
+    if (result == ESP_OK) {
+        ESP_LOGI(TAG, "Kalibrace ADC z eFuse: %s", scheme);
+    } else {
+        s_adc_cali = NULL;
+        ESP_LOGW(TAG, "Kalibrace ADC neni k dispozici (%s), pouzivam jmenovity rozsah %d mV",
+                 esp_err_to_name(result), LEVEL_ADC_NOMINAL_FULL_SCALE_MV);
+    }
+}
+
+/**
+ * Převede RAW ADC hodnotu na napětí podle charakteristiky čipu
+ * @param raw_value RAW hodnota z ADC
+ * @return napětí v mV
+ */
+static int adc_raw_to_mv(uint32_t raw_value)
+{
+    int voltage_mv = 0;
+    if (s_adc_cali != NULL && adc_cali_raw_to_voltage(s_adc_cali, (int)raw_value, &voltage_mv) == ESP_OK) {
+        return voltage_mv;
+    }
+    return (int)(raw_value * LEVEL_ADC_NOMINAL_FULL_SCALE_MV / 4095);
 }
 
 /**
@@ -178,6 +706,11 @@ static uint32_t adc_read_average(void)
  */
 static float adc_raw_to_height(uint32_t raw_value)
 {
+    // Kalibrační body v mV obcházejí nelinearitu ADC u krajů rozsahu
+    if (s_height_calibration.getCount() > 0) {
+        return s_height_calibration.evaluate((float)adc_raw_to_mv(raw_value));
+    }
+
     // Lineární interpolace
     float height = g_level_config.height_min + (float)((int)raw_value - g_level_config.adc_raw_min) *
                    (g_level_config.height_max - g_level_config.height_min) /
@@ -190,70 +723,87 @@ static float adc_raw_to_height(uint32_t raw_value)
     return height;
 }
 
-static void level_task(void *pvParameters)
+// Úloha plánovače: vzorky ADC každých lvl_sample_ms
+static void level_job(void *arg)
 {
-    ESP_LOGI(TAG, "Spouštění demá čtení hladiny...");
-    
-    // Inicializace ADC
-    if (adc_init() != ESP_OK) {
-        ESP_LOGE(TAG, "Chyba při inicializaci ADC");
-        vTaskDelete(NULL);
+    // Bez nové hodnoty ve filtru není co publikovat
+    if (adc_read_samples() == 0) {
         return;
     }
-    
-    // Nabití bufferu na začátku - přečteme tolik měření, jaká je velikost bufferu
-    // aby se zabránilo zkresleným údajům na začátku
-    size_t buffer_size = level_filter.getBufferSize();
-    ESP_LOGI(TAG, "Prebíhá nabití bufferu (%zu měření)...", buffer_size);
-    for (size_t i = 0; i < buffer_size; i++) {
-        adc_read_average();  // Jen vkládáme bez publikování
+
+    // Nabití bufferu na začátku - dokud filtr neobsahuje tolik měření, jaká
+    // je velikost bufferu, jen vkládáme bez publikování, aby se zabránilo
+    // zkresleným údajům na začátku
+    if (s_priming_samples_left > 0) {
+        return;
     }
-    ESP_LOGI(TAG, "Buffer nabití, začínáme publikovat výsledky");
+
+    // Oříznutý průměr z filtru
+    uint32_t raw_value = level_filter.getValue();
+
+    // Převod na výšku
+    float height = adc_raw_to_height(raw_value);
     
-    uint32_t raw_value;
-    float height;
+    // Výstup do logu (napětí slouží k sestavení kalibrační tabulky)
+    ESP_LOGD(TAG, "Surová hodnota: %lu | %d mV | Výška hladiny: %.3f m",
+             (unsigned long)raw_value, adc_raw_to_mv(raw_value), height);
+
+    // Ustálená hladina se neposílá dokola; pásmo kolem poslední odeslané
+    // hodnoty zároveň brání kmitání mezi dvěma sousedními hodnotami
+    const int64_t now_us = esp_timer_get_time();
+    if (s_level_published
+        && fabsf(height - s_published_height_m) < g_level_config.deadband_m
+        && now_us - s_published_at_us < (int64_t)g_level_config.max_silence_s * 1000000) {
+        return;
+    }
     
-    while (1)
-    {
-        // Čtení průměru z ADC
-        raw_value = adc_read_average();
-        
-        // Převod na výšku
-        height = adc_raw_to_height(raw_value);
-        
-        // Výstup do logu
-        //ESP_LOGI(TAG, "Surová hodnota: %lu | Výška hladiny: %.3f m", raw_value, height);
-        
-        app_event_t event = {
-            .event_type = EVT_SENSOR,
-            .timestamp_us = esp_timer_get_time(),
-            .data = {
-                .sensor = {
-                    .sensor_type = SENSOR_EVENT_LEVEL,
-                    .data = {
-                        .level = {
-                            .raw_value = raw_value,
-                            .height_m = height,
-                        },
+    app_event_t event = {
+        .event_type = EVT_SENSOR,
+        .timestamp_us = now_us,
+        .data = {
+            .sensor = {
+                .sensor_type = SENSOR_EVENT_LEVEL,
+                .data = {
+                    .level = {
+                        .raw_value = raw_value,
+                        .height_m = height,
+                        .volume_l = tank_geometry_volume_l(height),
                     },
                 },
             },
-        };
+        },
+    };
 
-        if (!sensor_events_publish(&event, pdMS_TO_TICKS(20))) {
-            ESP_LOGW(TAG, "Fronta sensor eventu je plna, hladina zahozena");
-        }
-        
-        // Čtení každou sekundu
-        vTaskDelay(pdMS_TO_TICKS(20));
+    if (!sensor_events_publish(&event)) {
+        ESP_LOGW(TAG, "Fronta odberatele sensor eventu je plna, hladina zahozena");
+        return; // zkusí se znovu s dalším vzorkem
     }
+
+    s_level_published = true;
+    s_published_height_m = height;
+    s_published_at_us = now_us;
 }
 
 void hladina_demo_init(void)
 {
+    ESP_LOGI(TAG, "Spouštění demá čtení hladiny...");
+
     load_level_calibration_config();
+    load_tank_geometry_config();
 
-    xTaskCreate(level_task, TAG, configMINIMAL_STACK_SIZE * 6, NULL, 5, NULL);
+    // Inicializace ADC
+    if (adc_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Chyba při inicializaci ADC");
+        return;
+    }
+    adc_calibration_init();
+
+    s_priming_samples_left = level_filter.getBufferSize();
+    ESP_LOGI(TAG, "Prebíhá nabití bufferu (%zu měření)...", s_priming_samples_left);
+
+    if (tick_scheduler_add_job(TAG, (uint32_t)g_level_config.sample_period_ms, level_job, NULL) == nullptr) {
+        ESP_LOGE(TAG, "Nelze naplanovat mereni hladiny");
+    }
 }
 
 config_group_t hladina_demo_get_config_group(void)
@@ -88,7 +88,7 @@ static void publish_network_event_from_mqtt(void)
         },
     };
 
-    if (!sensor_events_publish(&event, 0)) {
+    if (!sensor_events_publish(&event)) {
         ESP_LOGD(TAG, "Network event z MQTT nebylo mozne publikovat");
     }
 }
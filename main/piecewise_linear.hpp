@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cfloat>
+
+/**
+ * Rozparsuje body "x:y" oddělené čárkou nebo středníkem (mezery se ignorují).
+ * Souřadnice x musí ostře růst.
+ *
+ * @return počet bodů, 0 při chybě nebo překročení max_points
+ */
+inline size_t parsePiecewisePoints(const char *text, float *xs, float *ys, size_t max_points)
+{
+    size_t points = 0;
+    const char *cursor = text;
+    while (*cursor != '\0')
+    {
+        while (*cursor == ' ' || *cursor == ',' || *cursor == ';')
+        {
+            ++cursor;
+        }
+        if (*cursor == '\0')
+        {
+            break;
+        }
+        if (points == max_points)
+        {
+            return 0;
+        }
+
+        char *end = nullptr;
+        const float x = strtof(cursor, &end);
+        if (end == cursor || *end != ':')
+        {
+            return 0;
+        }
+        cursor = end + 1;
+        const float y = strtof(cursor, &end);
+        if (end == cursor)
+        {
+            return 0;
+        }
+        cursor = end;
+
+        if (points > 0 && x <= xs[points - 1])
+        {
+            return 0;
+        }
+        xs[points] = x;
+        ys[points] = y;
+        ++points;
+    }
+    return points;
+}
+
+/**
+ * Po částech lineární funkce zadaná body (např. kalibrace napětí -> výška)
+ *
+ * Úsek se hledá půlením s pevným počtem kroků bez podmíněných skoků
+ * (porovnání se přeloží na podmíněný přesun), takže vyhodnocení stojí
+ * vždy stejně. Mimo zadané body se pokračuje krajním úsekem.
+ *
+ * Parametry template:
+ * - MaxPoints: maximální počet bodů, mocnina 2
+ *
+ * Příklad:
+ *   PiecewiseLinear<16> calibration;
+ *   calibration.parse("150:0, 900:0.5, 2450:1.8");
+ *   float height = calibration.evaluate(mv);
+ */
+template<size_t MaxPoints = 16>
+class PiecewiseLinear
+{
+private:
+    static_assert(MaxPoints >= 2 && (MaxPoints & (MaxPoints - 1)) == 0, "MaxPoints musí být mocnina 2");
+
+    float xs[MaxPoints];       // začátky úseků, nevyužité na konci FLT_MAX
+    float ys[MaxPoints];
+    float slopes[MaxPoints];   // sklon úseku začínajícího v xs[i]
+    size_t count;
+
+public:
+    PiecewiseLinear() : count(0)
+    {
+        // Bez bodů vrací evaluate() nulu
+        for (size_t i = 0; i < MaxPoints; ++i)
+        {
+            xs[i] = FLT_MAX;
+            ys[i] = 0.0f;
+            slopes[i] = 0.0f;
+        }
+    }
+
+    /**
+     * Nastaví body funkce
+     *
+     * @param x ostře rostoucí souřadnice
+     * @param y hodnoty v bodech
+     * @param n počet bodů, 2 až MaxPoints
+     * @return false pokud body nejsou platné (funkce zůstane beze změny)
+     */
+    bool set(const float *x, const float *y, size_t n)
+    {
+        if (n < 2 || n > MaxPoints)
+        {
+            return false;
+        }
+        for (size_t i = 1; i < n; ++i)
+        {
+            if (!(x[i] > x[i - 1]))
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            xs[i] = x[i];
+            ys[i] = y[i];
+        }
+        for (size_t i = 0; i + 1 < n; ++i)
+        {
+            slopes[i] = (ys[i + 1] - ys[i]) / (xs[i + 1] - xs[i]);
+        }
+        // Za posledním bodem pokračuje poslední úsek
+        slopes[n - 1] = slopes[n - 2];
+        for (size_t i = n; i < MaxPoints; ++i)
+        {
+            xs[i] = FLT_MAX;
+            ys[i] = ys[n - 1];
+            slopes[i] = slopes[n - 1];
+        }
+        count = n;
+        return true;
+    }
+
+    /**
+     * Nastaví body z textu "x:y,x:y,..."
+     *
+     * @return false při chybě formátu nebo méně než 2 bodech
+     */
+    bool parse(const char *text)
+    {
+        float x[MaxPoints];
+        float y[MaxPoints];
+        const size_t n = parsePiecewisePoints(text, x, y, MaxPoints);
+        return set(x, y, n);
+    }
+
+    /**
+     * Vyhodnotí funkci v bodě x
+     *
+     * @return hodnota funkce
+     */
+    float evaluate(float x) const
+    {
+        // Největší i s xs[i] <= x (nebo 0), pevně log2(MaxPoints) kroků
+        size_t base = 0;
+        for (size_t step = MaxPoints / 2; step > 0; step >>= 1)
+        {
+            base += (xs[base + step] <= x) ? step : 0;
+        }
+        return ys[base] + (x - xs[base]) * slopes[base];
+    }
+
+    /**
+     * Vrátí počet nastavených bodů
+     *
+     * @return počet bodů (0 = nenastaveno)
+     */
+    size_t getCount() const
+    {
+        return count;
+    }
+
+};
@@ -1,3 +1,9 @@
+// 1 = pulzy pocita preruseni na kazdou nabeznou hranu (puvodni reseni),
+// 0 = pulzy pocita HW citac PCNT s filtrem zakmitu, CPU ho jen cte
+#ifndef PRUTOKOMER_USE_GPIO_ISR
+#define PRUTOKOMER_USE_GPIO_ISR 0
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -6,154 +12,921 @@ extern "C" {
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "nvs.h"
 #include "driver/gpio.h"
+#if !PRUTOKOMER_USE_GPIO_ISR
+#include "driver/pulse_cnt.h"
+#endif
 
 #ifdef __cplusplus
 }
 #endif
 
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+
+#include "prutokomer.h"
 #include "pins.h"
 #include "sensor_events.h"
+#include "tick_scheduler.h"
 #include "flash_monotonic_counter.h"
+#include "diag_publisher.h"
 
 #define TAG "FLOW"
 
-static constexpr uint32_t FLOW_PULSES_PER_LITER = 270; // F = 4.5 * Q, Q v l/min
-static constexpr uint32_t COUNTER_INCREMENT_LITERS = 10;
-static constexpr uint32_t PULSES_PER_COUNTER_INCREMENT = FLOW_PULSES_PER_LITER * COUNTER_INCREMENT_LITERS;
-static constexpr TickType_t FLOW_SAMPLE_PERIOD = pdMS_TO_TICKS(200);
+static constexpr int32_t FLOW_DEFAULT_PULSES_PER_LITER = 270; // F = 4.5 * Q, Q v l/min
+static constexpr int32_t FLOW_DEFAULT_STEP_LITERS = 10;
+static constexpr int32_t FLOW_DEFAULT_FLASH_CYCLES = 100000;
+static constexpr int32_t FLOW_DEFAULT_SAMPLE_PERIOD_MS = 200;
 static constexpr float FLOW_EMA_ALPHA = 0.25f;
-static constexpr UBaseType_t FLOW_TASK_STACK_SIZE = 4096;
 static constexpr uint8_t FLOW_LOG_EVERY_N_SAMPLES = 5;
 static const char *FLOW_COUNTER_PARTITION_LABEL = "flow_data0";
+static const char *FLOW_NVS_NAMESPACE = "flow";
+static const char *FLOW_NVS_SCALE_KEY = "scale";
+// Odhad zivotnosti z prumeru od startu ma smysl az po nejake dobe behu
+static constexpr int64_t FLOW_WEAR_MIN_UPTIME_US = 3600LL * 1000000LL;
 
-// sdílený counter z ISR
-static volatile uint32_t pulse_count = 0;
-static FlashMonotonicCounter s_flow_counter;
+static const config_item_t FLOW_CONFIG_ITEMS[] = {
+    {
+        .key = "flow_pulses_l",
+        .label = "Prutokomer pulzu na litr",
+        .description = "Konstanta prutokomeru (pulzy na 1 l). Projevi se po restartu.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = FLOW_DEFAULT_PULSES_PER_LITER,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 1,
+        .max_int = 10000,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+    {
+        .key = "flow_step_l",
+        .label = "Krok ulozeni objemu [l]",
+        .description = "Po kolika litrech se celkovy objem zapisuje do flash. Mensi krok = presnejsi "
+                       "objem po vypadku napajeni, ale rychlejsi opotrebeni flash (viz diag/flow/wear).",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = FLOW_DEFAULT_STEP_LITERS,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 1,
+        .max_int = 1000,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+    {
+        .key = "flash_cycles",
+        .label = "Zivotnost flash [cyklu]",
+        .description = "Zarucovany pocet mazani sektoru flash podle datasheetu, pro odhad zivotnosti.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = FLOW_DEFAULT_FLASH_CYCLES,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 1000,
+        .max_int = 10000000,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+    {
+        .key = "flow_sample_ms",
+        .label = "Perioda vzorkovani prutoku [ms]",
+        .description = "Jak casto se odecita citac pulzu a prepocitava prutok. Nejvys 1 s, "
+                       "aby se hrany z jedne periody vesly do bufferu.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = FLOW_DEFAULT_SAMPLE_PERIOD_MS,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 50,
+        .max_int = 1000,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+};
+
+// Prevod kroku flash counteru na litry. Counter jen roste, proto se pri zmene
+// velikosti kroku nic neprepisuje: zapamatuje se hodnota counteru a objem
+// v okamziku zmeny a dalsi kroky se pocitaji novou velikosti. Jeden blob v NVS
+// se zapisuje atomicky, takze vypadek napajeni nemuze nechat polovicni zmenu.
+typedef struct {
+    uint32_t liters_per_step;
+    uint32_t reserved;
+    uint64_t origin_steps;  // hodnota counteru pri posledni zmene kroku
+    uint64_t origin_liters; // objem odpovidajici origin_steps
+} flow_scale_t;
+
+// Pri malem prutoku dava vychozi okno 200 ms jen 0/1 pulz (1 pulz = 1.1 l/min), proto
+// se prutok pocita z periody mezi pulzy. Hrany casuje preruseni jen v tomto
+// rezimu, takze jeho frekvence je shora omezena (5 l/min = 22.5 Hz).
+static constexpr float FLOW_PERIOD_MODE_ENTER_L_MIN = 3.0f;
+static constexpr float FLOW_PERIOD_MODE_EXIT_L_MIN = 5.0f;
+// Bez pulzu dele nez tohle se prutok povazuje za nulovy
+static constexpr int64_t FLOW_PERIOD_TIMEOUT_US = 5000000;
+// Hrany blize nez tohle jsou zakmit (pri 5 l/min je perioda 44 ms)
+static constexpr int64_t FLOW_EDGE_MIN_SPACING_US = 2000;
+static constexpr uint32_t FLOW_EDGE_RING_SIZE = 32; // mocnina 2
+
+// Zapis do flash (rollover = mazani 8 KB + 2x NVS commit) trva az stovky ms,
+// proto ho dela samostatny task a vzorkovani mu jen predava pocet kroku
+static constexpr uint32_t FLOW_PERSIST_TASK_STACK_SIZE = 3072;
+static constexpr UBaseType_t FLOW_PERSIST_TASK_PRIORITY = 3;
+static constexpr uint32_t FLOW_PERSIST_RETRY_MS = 1000;
+
+static FlashMonotonicCounter s_flow_counter;   // vlastni ho jen persistencni task
 static uint64_t s_total_pulses = 0;
-static uint64_t s_persisted_counter_steps = 0;
+// Nactene z konfigurace v prutokomer_init(), za behu se nemeni
+static uint32_t s_pulses_per_liter = FLOW_DEFAULT_PULSES_PER_LITER;
+static uint32_t s_flash_rated_cycles = FLOW_DEFAULT_FLASH_CYCLES;
+static flow_scale_t s_flow_scale = {FLOW_DEFAULT_STEP_LITERS, 0, 0, 0};
+static uint64_t s_scale_origin_pulses = 0; // origin_liters v pulzech
+static uint64_t s_pulses_per_step = 0;
+static uint64_t s_requested_counter_steps = 0; // kroky predane persistencnimu tasku
+
+// Schranka sampling -> persistence: pocet kroku cekajicich na zapis
+static std::atomic<uint32_t> s_pending_steps{0};
+static std::atomic<int64_t> s_pending_since_us{0};
+static TaskHandle_t s_persist_task = nullptr;
+
+typedef struct {
+    uint32_t requested_steps;   // kroky predane ke zapisu
+    uint32_t persisted_steps;   // kroky uspesne zapsane
+    uint32_t write_errors;
+    uint32_t max_pending_steps; // nejvic kroku najednou ve schrance
+    uint32_t last_queue_ms;     // cekani od predani po zacatek zapisu
+    uint32_t max_queue_ms;
+    uint32_t last_flush_ms;     // trvani samotneho zapisu
+    uint32_t max_flush_ms;
+    // Stav counteru po poslednim zapisu - counter vlastni persistencni task,
+    // diagnostika cte jen tuto kopii
+    uint32_t flash_holes;
+    uint32_t sector_count;
+    uint32_t bits_per_sector;
+    uint64_t sector_erases;
+} flow_persist_stats_t;
+
+// Zrcadlo totalizeru v RTC pameti. Do flash jdou jen cele kroky (typicky 10 l), bez
+// zrcadla by kazdy reset (watchdog, OTA, pad) zahodil rozpracovany krok.
+// Po zapnuti napajeni je obsah nahodny, odhali ho magic a kontrolni soucet.
+static constexpr uint32_t FLOW_RTC_MAGIC = 0x574F4C46; // "FLOW"
+// Zrcadlo smi byt pred flash nejvys o tolik kroku (nezapsane kroky write-behind)
+static constexpr uint64_t FLOW_RTC_MAX_UNPERSISTED_STEPS = 16;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t last_sample_uptime_ms;
+    uint32_t pulses_per_liter;  // po zmene konstanty jsou pulzy v jinych jednotkach
+    uint64_t total_pulses;
+    float flow_l_min_ema;
+    uint32_t checksum;
+} flow_rtc_state_t;
+
+static RTC_NOINIT_ATTR flow_rtc_state_t s_flow_rtc;
+
+static flow_persist_stats_t s_persist_stats = {};
+static portMUX_TYPE s_persist_stats_lock = portMUX_INITIALIZER_UNLOCKED;
 static float s_flow_l_min_ema = 0.0f;
 static bool s_flow_ema_initialized = false;
+static uint32_t s_previous_pulse_count = 0;
+static int64_t s_previous_sample_us = 0;
+static uint8_t s_sample_counter = 0;
+
+// Casy hran z preruseni: jeden zapisovatel (ISR), jeden ctenar (vzorkovaci uloha)
+static int64_t s_edge_ring[FLOW_EDGE_RING_SIZE];
+static std::atomic<uint32_t> s_edge_head{0};
+static std::atomic<uint32_t> s_edge_tail{0};
+// Ring pretekl - nektere hrany chybi, posledni prevzata hrana neni posledni skutecna
+static std::atomic<bool> s_edge_overflow{false};
+static volatile bool s_period_mode = false;
+static int64_t s_isr_last_edge_us = 0;
+static int64_t s_last_edge_us = 0;       // posledni hrana prevzata ulohou (0 = zadna)
+static float s_period_flow_l_min = 0.0f;
+
+static inline void IRAM_ATTR flow_edge_record(void)
+{
+    const int64_t now_us = esp_timer_get_time();
+    if (now_us - s_isr_last_edge_us < FLOW_EDGE_MIN_SPACING_US) {
+        return;
+    }
+    s_isr_last_edge_us = now_us;
+
+    const uint32_t head = s_edge_head.load(std::memory_order_relaxed);
+    if (head - s_edge_tail.load(std::memory_order_acquire) >= FLOW_EDGE_RING_SIZE) {
+        // Plno - prutok prudce vzrostl a uloha nestiha, hrana se zahodi
+        s_edge_overflow.store(true, std::memory_order_relaxed);
+        return;
+    }
+    s_edge_ring[head & (FLOW_EDGE_RING_SIZE - 1)] = now_us;
+    s_edge_head.store(head + 1, std::memory_order_release);
+}
+
+#if PRUTOKOMER_USE_GPIO_ISR
+
+// sdílený counter z ISR
+static volatile uint32_t pulse_count = 0;
 
 // ISR handler
 static void IRAM_ATTR flow_isr_handler(void *arg) {
     pulse_count += 1;
+    if (s_period_mode) {
+        flow_edge_record();
+    }
 }
 
-static void pocitani_pulsu(void *pvParameters)
+// Preruseni bezi na kazdou hranu vzdy, casovani se jen zapina priznakem
+static void flow_edge_capture_enable(bool enable)
 {
-    uint32_t previous_pulse_count = pulse_count;
-    int64_t previous_sample_us = esp_timer_get_time();
-    uint8_t sample_counter = 0;
+}
 
-    while(1) {
-        vTaskDelay(FLOW_SAMPLE_PERIOD);
+static esp_err_t flow_pulse_counter_init(void)
+{
+    // --- Nastavení GPIO pro flow senzor ---
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << FLOW_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_POSEDGE
+    };
+    gpio_config(&io_conf);
 
-        const int64_t now_us = esp_timer_get_time();
-        const int64_t elapsed_us = now_us - previous_sample_us;
-        previous_sample_us = now_us;
+    gpio_install_isr_service(0);
+    return gpio_isr_handler_add(FLOW_GPIO, flow_isr_handler, NULL);
+}
 
-        const uint32_t current_pulse_count = pulse_count;
-        const uint32_t new_pulses = current_pulse_count - previous_pulse_count;
-        previous_pulse_count = current_pulse_count;
+static uint32_t flow_pulse_count(void)
+{
+    return pulse_count;
+}
 
-        s_total_pulses += new_pulses;
-//        ESP_LOGI(TAG, "Nové pulzy: %lu, Celkem pulzů: %llu, Elapsed: %lld us",
-  //               new_pulses,
-    //             (unsigned long long)s_total_pulses,
-      //           (long long)elapsed_us);
+#else
+
+// Mez HW citace. Pri jejim dosazeni driver pricte hodnotu do SW akumulatoru
+// (accum_count) a citac vynuluje, takze preruseni je jen jedno za
+// FLOW_PCNT_HIGH_LIMIT pulzu (cca 37 l) bez ohledu na prutok.
+static constexpr int FLOW_PCNT_HIGH_LIMIT = 10000;
+// Filtr zakmitu - kratsi impulzy se ignoruji. HW umi nejvyse 1023 taktu APB
+// (cca 12.7 us), pri 100 l/min ma pulz periodu cca 2.2 ms.
+static constexpr uint32_t FLOW_PCNT_GLITCH_NS = 10000;
+
+static pcnt_unit_handle_t s_pcnt_unit = nullptr;
+
+// Akumulaci pri pretečeni dela ISR driveru, ten se instaluje jen s callbackem
+static bool IRAM_ATTR flow_pcnt_on_reach(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *edata, void *user_ctx)
+{
+    return false;
+}
+
+static void IRAM_ATTR flow_edge_isr_handler(void *arg)
+{
+    flow_edge_record();
+}
+
+// Casovaci preruseni je nezavisle na PCNT a zapina se jen pri malem prutoku
+static void flow_edge_capture_enable(bool enable)
+{
+    if (enable) {
+        gpio_intr_enable(FLOW_GPIO);
+    } else {
+        gpio_intr_disable(FLOW_GPIO);
+    }
+}
+
+static esp_err_t flow_pulse_counter_init(void)
+{
+    pcnt_unit_config_t unit_config = {};
+    unit_config.low_limit = -1;   // driver vyzaduje zapornou dolni mez, citame jen nahoru
+    unit_config.high_limit = FLOW_PCNT_HIGH_LIMIT;
+    unit_config.flags.accum_count = 1;
+    esp_err_t result = pcnt_new_unit(&unit_config, &s_pcnt_unit);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    pcnt_glitch_filter_config_t filter_config = {};
+    filter_config.max_glitch_ns = FLOW_PCNT_GLITCH_NS;
+    result = pcnt_unit_set_glitch_filter(s_pcnt_unit, &filter_config);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    pcnt_chan_config_t chan_config = {};
+    chan_config.edge_gpio_num = FLOW_GPIO;
+    chan_config.level_gpio_num = -1;
+    pcnt_channel_handle_t channel = nullptr;
+    result = pcnt_new_channel(s_pcnt_unit, &chan_config, &channel);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    // Stejne jako puvodni ISR pocitame jen nabezne hrany
+    result = pcnt_channel_set_edge_action(channel, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_HOLD);
+    if (result != ESP_OK) {
+        return result;
+    }
+    gpio_set_pull_mode(FLOW_GPIO, GPIO_PULLUP_ONLY);
+
+    result = pcnt_unit_add_watch_point(s_pcnt_unit, FLOW_PCNT_HIGH_LIMIT);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    pcnt_event_callbacks_t callbacks = {};
+    callbacks.on_reach = flow_pcnt_on_reach;
+    result = pcnt_unit_register_event_callbacks(s_pcnt_unit, &callbacks, NULL);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    // Na stejnem pinu je jeste GPIO preruseni pro casovani hran, zatim vypnute
+    gpio_set_intr_type(FLOW_GPIO, GPIO_INTR_POSEDGE);
+    gpio_install_isr_service(0);
+    result = gpio_isr_handler_add(FLOW_GPIO, flow_edge_isr_handler, NULL);
+    if (result != ESP_OK) {
+        return result;
+    }
+    gpio_intr_disable(FLOW_GPIO);
+
+    result = pcnt_unit_enable(s_pcnt_unit);
+    if (result != ESP_OK) {
+        return result;
+    }
+    result = pcnt_unit_clear_count(s_pcnt_unit);
+    if (result != ESP_OK) {
+        return result;
+    }
+    return pcnt_unit_start(s_pcnt_unit);
+}
+
+// Akumulovany stav citace; pretekani int se projevi jen jako modulo 2^32,
+// se kterym vzorkovani pocita (rozdil dvou cteni je bez znamenka)
+static uint32_t flow_pulse_count(void)
+{
+    int count = 0;
+    if (pcnt_unit_get_count(s_pcnt_unit, &count) != ESP_OK) {
+        return s_previous_pulse_count;
+    }
+    return static_cast<uint32_t>(count);
+}
+
+#endif
+
+static uint64_t flow_steps_to_liters(uint64_t steps)
+{
+    return s_flow_scale.origin_liters + (steps - s_flow_scale.origin_steps) * s_flow_scale.liters_per_step;
+}
+
+/**
+ * Nacte prevod kroku na litry z NVS a pokud se v konfiguraci zmenila velikost
+ * kroku, zalozi novy prevod od aktualni hodnoty counteru.
+ * @param step_liters nastavena velikost kroku
+ */
+static esp_err_t flow_scale_load(uint32_t step_liters, uint64_t counter_steps)
+{
+    nvs_handle_t handle;
+    esp_err_t result = nvs_open(FLOW_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    flow_scale_t stored = {};
+    size_t size = sizeof(stored);
+    result = nvs_get_blob(handle, FLOW_NVS_SCALE_KEY, &stored, &size);
+    if (result == ESP_ERR_NVS_NOT_FOUND) {
+        // Puvodni firmware mel pevny krok od nuly
+        stored = {static_cast<uint32_t>(FLOW_DEFAULT_STEP_LITERS), 0, 0, 0};
+        result = ESP_OK;
+    } else if (result == ESP_OK && (size != sizeof(stored) || stored.liters_per_step == 0)) {
+        result = ESP_ERR_INVALID_SIZE;
+    }
+    if (result != ESP_OK) {
+        nvs_close(handle);
+        return result;
+    }
+
+    if (counter_steps < stored.origin_steps) {
+        // Counter nekdo vynuloval (reset()) - objem zacina znovu od nuly
+        ESP_LOGW(TAG, "Flow counter je pod pocatkem prevodu (%llu < %llu), prevod od nuly",
+                 (unsigned long long)counter_steps,
+                 (unsigned long long)stored.origin_steps);
+        stored.origin_steps = 0;
+        stored.origin_liters = 0;
+    }
+    s_flow_scale = stored;
+
+    if (stored.liters_per_step != step_liters) {
+        flow_scale_t changed = {step_liters, 0, counter_steps, flow_steps_to_liters(counter_steps)};
+        result = nvs_set_blob(handle, FLOW_NVS_SCALE_KEY, &changed, sizeof(changed));
+        if (result == ESP_OK) {
+            result = nvs_commit(handle);
+        }
+        if (result != ESP_OK) {
+            nvs_close(handle);
+            return result;
+        }
+        ESP_LOGW(TAG, "Krok ulozeni objemu zmenen z %lu l na %lu l pri %llu l",
+                 (unsigned long)stored.liters_per_step,
+                 (unsigned long)step_liters,
+                 (unsigned long long)changed.origin_liters);
+        s_flow_scale = changed;
+    }
+
+    nvs_close(handle);
+    return ESP_OK;
+}
+
+static uint32_t flow_rtc_checksum(const flow_rtc_state_t *state)
+{
+    // FNV-1a pres vse krome samotneho souctu
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(state);
+    uint32_t hash = 2166136261u;
+    for (size_t index = 0; index < offsetof(flow_rtc_state_t, checksum); ++index) {
+        hash ^= bytes[index];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void flow_rtc_save(int64_t now_us)
+{
+    s_flow_rtc.magic = FLOW_RTC_MAGIC;
+    s_flow_rtc.last_sample_uptime_ms = static_cast<uint32_t>(now_us / 1000);
+    s_flow_rtc.pulses_per_liter = s_pulses_per_liter;
+    s_flow_rtc.total_pulses = s_total_pulses;
+    s_flow_rtc.flow_l_min_ema = s_flow_l_min_ema;
+    s_flow_rtc.checksum = flow_rtc_checksum(&s_flow_rtc);
+}
 
-        const uint64_t target_persisted_steps = s_total_pulses / PULSES_PER_COUNTER_INCREMENT;
-        while (s_persisted_counter_steps < target_persisted_steps) {
-            const esp_err_t increment_result = s_flow_counter.increment(1);
+/**
+ * Obnovi totalizer ze zrcadla v RTC pameti, pokud prezilo reset a sedi
+ * k hodnote ve flash.
+ * @param flash_steps kroky nactene z flash counteru
+ */
+static bool flow_rtc_restore(uint64_t flash_steps)
+{
+    const esp_reset_reason_t reason = esp_reset_reason();
+    const bool ram_retained = reason != ESP_RST_POWERON
+                           && reason != ESP_RST_BROWNOUT
+                           && reason != ESP_RST_UNKNOWN;
+    if (!ram_retained
+        || s_flow_rtc.magic != FLOW_RTC_MAGIC
+        || s_flow_rtc.checksum != flow_rtc_checksum(&s_flow_rtc)
+        || s_flow_rtc.pulses_per_liter != s_pulses_per_liter) {
+        return false;
+    }
+
+    const uint64_t flash_pulses = flow_steps_to_liters(flash_steps) * s_pulses_per_liter;
+    const uint64_t max_pulses = flow_steps_to_liters(flash_steps + FLOW_RTC_MAX_UNPERSISTED_STEPS) * s_pulses_per_liter;
+    if (s_flow_rtc.total_pulses < flash_pulses || s_flow_rtc.total_pulses >= max_pulses) {
+        ESP_LOGW(TAG,
+                 "Zrcadlo prutoku v RTC nesedi k flash (%llu pulzu, flash %llu kroku), ignoruji",
+                 (unsigned long long)s_flow_rtc.total_pulses,
+                 (unsigned long long)flash_steps);
+        return false;
+    }
+
+    s_total_pulses = s_flow_rtc.total_pulses;
+    s_flow_l_min_ema = s_flow_rtc.flow_l_min_ema;
+    s_flow_ema_initialized = true;
+    ESP_LOGW(TAG,
+             "Totalizer obnoven z RTC: %llu pulzu (+%llu proti flash), posledni vzorek v %lu ms behu",
+             (unsigned long long)s_total_pulses,
+             (unsigned long long)(s_total_pulses - flash_pulses),
+             (unsigned long)s_flow_rtc.last_sample_uptime_ms);
+    return true;
+}
+
+// Volat jen z vlastnika counteru (init, pak persistencni task)
+static void flow_counter_snapshot(void)
+{
+    const uint32_t holes = s_flow_counter.scan_holes();
+    const uint32_t sectors = s_flow_counter.sector_count();
+    const uint32_t bits_per_sector = s_flow_counter.bits_per_sector();
+    const uint64_t erases = s_flow_counter.sector_erases();
+
+    taskENTER_CRITICAL(&s_persist_stats_lock);
+    s_persist_stats.flash_holes = holes;
+    s_persist_stats.sector_count = sectors;
+    s_persist_stats.bits_per_sector = bits_per_sector;
+    s_persist_stats.sector_erases = erases;
+    taskEXIT_CRITICAL(&s_persist_stats_lock);
+}
+
+// Volano ze vzorkovaci ulohy, nikdy neblokuje
+static void flow_persist_request(uint32_t steps)
+{
+    // Cas se zapise pred zverejnenim kroku, takze ho persistencni task po
+    // prevzeti kroku vzdy vidi; kdyz task schranku mezitim vyprazdni, CAS
+    // selze a cas se zapise znovu
+    const int64_t now_us = esp_timer_get_time();
+    uint32_t pending = s_pending_steps.load(std::memory_order_relaxed);
+    do {
+        if (pending == 0) {
+            s_pending_since_us.store(now_us, std::memory_order_relaxed);
+        }
+    } while (!s_pending_steps.compare_exchange_weak(pending, pending + steps,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed));
+
+    taskENTER_CRITICAL(&s_persist_stats_lock);
+    s_persist_stats.requested_steps += steps;
+    taskEXIT_CRITICAL(&s_persist_stats_lock);
+
+    xTaskNotifyGive(s_persist_task);
+}
+
+static void flow_persist_task(void *pvParameters)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        uint32_t steps = s_pending_steps.exchange(0, std::memory_order_acq_rel);
+        const int64_t pending_since_us = s_pending_since_us.load(std::memory_order_relaxed);
+        while (steps > 0) {
+            const uint64_t value_before = s_flow_counter.value();
+            const int64_t start_us = esp_timer_get_time();
+            const esp_err_t increment_result = s_flow_counter.increment(steps);
+            const int64_t end_us = esp_timer_get_time();
+
+            // Counter zapisuje po blocich; pri chybe muze byt cast kroku uz ve flash
+            uint32_t committed = steps;
+            if (increment_result != ESP_OK) {
+                const uint64_t value_after = s_flow_counter.value();
+                committed = value_after > value_before
+                    ? static_cast<uint32_t>(std::min<uint64_t>(value_after - value_before, steps))
+                    : 0;
+            }
+
+            const uint32_t queue_ms = static_cast<uint32_t>((start_us - pending_since_us) / 1000);
+            const uint32_t flush_ms = static_cast<uint32_t>((end_us - start_us) / 1000);
+
+            taskENTER_CRITICAL(&s_persist_stats_lock);
+            if (steps > s_persist_stats.max_pending_steps) {
+                s_persist_stats.max_pending_steps = steps;
+            }
+            s_persist_stats.last_queue_ms = queue_ms;
+            if (queue_ms > s_persist_stats.max_queue_ms) {
+                s_persist_stats.max_queue_ms = queue_ms;
+            }
+            s_persist_stats.last_flush_ms = flush_ms;
+            if (flush_ms > s_persist_stats.max_flush_ms) {
+                s_persist_stats.max_flush_ms = flush_ms;
+            }
+            s_persist_stats.persisted_steps += committed;
             if (increment_result != ESP_OK) {
-                ESP_LOGE(TAG, "Nelze zapsat flow counter: %s", esp_err_to_name(increment_result));
+                s_persist_stats.write_errors += 1;
+            }
+            taskEXIT_CRITICAL(&s_persist_stats_lock);
+            flow_counter_snapshot();
+
+            if (increment_result == ESP_OK) {
                 break;
             }
-            s_persisted_counter_steps += 1;
+
+            ESP_LOGE(TAG,
+                     "Nelze zapsat flow counter (zapsano %lu z %lu kroku): %s",
+                     (unsigned long)committed,
+                     (unsigned long)steps,
+                     esp_err_to_name(increment_result));
+            // Nezapsany zbytek se neztrati - prida se k dalsim a zkusi se znovu
+            vTaskDelay(pdMS_TO_TICKS(FLOW_PERSIST_RETRY_MS));
+            steps = steps - committed + s_pending_steps.exchange(0, std::memory_order_acq_rel);
         }
+    }
+}
+
+static void flow_persist_diag(void)
+{
+    flow_persist_stats_t stats;
+    taskENTER_CRITICAL(&s_persist_stats_lock);
+    stats = s_persist_stats;
+    taskEXIT_CRITICAL(&s_persist_stats_lock);
+
+    char payload[224];
+    snprintf(payload,
+             sizeof(payload),
+             "{\"requested\":%lu,\"persisted\":%lu,\"pending\":%lu,\"errors\":%lu,"
+             "\"max_pending\":%lu,\"queue_ms\":%lu,\"max_queue_ms\":%lu,"
+             "\"flush_ms\":%lu,\"max_flush_ms\":%lu,\"flash_holes\":%lu}",
+             (unsigned long)stats.requested_steps,
+             (unsigned long)stats.persisted_steps,
+             (unsigned long)s_pending_steps.load(std::memory_order_relaxed),
+             (unsigned long)stats.write_errors,
+             (unsigned long)stats.max_pending_steps,
+             (unsigned long)stats.last_queue_ms,
+             (unsigned long)stats.max_queue_ms,
+             (unsigned long)stats.last_flush_ms,
+             (unsigned long)stats.max_flush_ms,
+             (unsigned long)stats.flash_holes);
+    diag_publish("flow/persist", payload);
+}
+
+/**
+ * Odhad opotrebeni flash counteru. Kazdy krok vynuluje jeden bit, kazdych
+ * bits_per_sector kroku se jednou maze sektor a mazani se stridaji po kruhu,
+ * takze celkem vydrzi sector_count * rated_cycles mazani.
+ */
+static void flow_wear_diag(void)
+{
+    flow_persist_stats_t stats;
+    taskENTER_CRITICAL(&s_persist_stats_lock);
+    stats = s_persist_stats;
+    taskEXIT_CRITICAL(&s_persist_stats_lock);
+
+    const uint64_t bits_per_sector = stats.bits_per_sector;
+    const uint64_t erase_budget = static_cast<uint64_t>(stats.sector_count) * s_flash_rated_cycles;
+    const uint64_t erases = stats.sector_erases;
+    const uint64_t erases_left = erases < erase_budget ? erase_budget - erases : 0;
+    const uint64_t remaining_l = erases_left * bits_per_sector * s_flow_scale.liters_per_step;
+    const float wear_pct = erase_budget > 0
+        ? 100.0f * static_cast<float>(erases) / static_cast<float>(erase_budget)
+        : 0.0f;
 
-        float raw_flow_l_min = 0.0f;
-        if (elapsed_us > 0) {
-            raw_flow_l_min = (static_cast<float>(new_pulses) * 60000000.0f)
-                           / (static_cast<float>(elapsed_us) * static_cast<float>(FLOW_PULSES_PER_LITER));
+    // Denni objem z toho, co se od startu skutecne zapsalo
+    char daily_l[16] = "null";
+    char remaining_years[16] = "null";
+    const int64_t uptime_us = esp_timer_get_time();
+    if (uptime_us >= FLOW_WEAR_MIN_UPTIME_US) {
+        const float days = static_cast<float>(uptime_us) / (86400.0f * 1000000.0f);
+        const float steps_per_day = static_cast<float>(stats.persisted_steps) / days;
+        snprintf(daily_l, sizeof(daily_l), "%.1f", steps_per_day * static_cast<float>(s_flow_scale.liters_per_step));
+        if (steps_per_day > 0.0f) {
+            const float days_left = static_cast<float>(erases_left) * static_cast<float>(bits_per_sector) / steps_per_day;
+            snprintf(remaining_years, sizeof(remaining_years), "%.1f", days_left / 365.0f);
         }
+    }
+
+    char payload[256];
+    snprintf(payload,
+             sizeof(payload),
+             "{\"step_l\":%lu,\"sectors\":%lu,\"bits_per_sector\":%lu,\"erases\":%llu,"
+             "\"rated_cycles\":%lu,\"wear_pct\":%.3f,\"remaining_l\":%llu,"
+             "\"daily_l\":%s,\"remaining_years\":%s}",
+             (unsigned long)s_flow_scale.liters_per_step,
+             (unsigned long)stats.sector_count,
+             (unsigned long)bits_per_sector,
+             (unsigned long long)erases,
+             (unsigned long)s_flash_rated_cycles,
+             wear_pct,
+             (unsigned long long)remaining_l,
+             daily_l,
+             remaining_years);
+    diag_publish("flow/wear", payload);
+}
 
-        if (!s_flow_ema_initialized) {
-            s_flow_l_min_ema = raw_flow_l_min;
-            s_flow_ema_initialized = true;
+static void flow_period_mode_set(bool enable, float flow_l_min)
+{
+    if (enable == s_period_mode) {
+        return;
+    }
+
+    if (enable) {
+        // Stare hrany z minuleho rezimu nepatri k sobe
+        s_edge_tail.store(s_edge_head.load(std::memory_order_acquire), std::memory_order_release);
+        s_edge_overflow.store(false, std::memory_order_relaxed);
+        s_last_edge_us = 0;
+        s_period_flow_l_min = flow_l_min;
+    }
+    s_period_mode = enable;
+    flow_edge_capture_enable(enable);
+    ESP_LOGI(TAG, "Mereni prutoku %s", enable ? "z periody pulzu" : "poctem pulzu");
+}
+
+/**
+ * Prevezme casy hran a spocte prutok z prumerne periody mezi nimi.
+ * Bez novych hran drzi posledni hodnotu, dokud doba od posledni hrany
+ * nepreroste periodu - pak ji shora omezuje, takze zastaveni prutoku
+ * se projevi plynulym poklesem az k nule.
+ * @param count_flow_l_min prutok z poctu pulzu v okne, plati pri preteceni ringu
+ * @return false pokud zatim neni z ceho periodu spocitat
+ */
+static bool flow_period_sample(int64_t now_us, float count_flow_l_min, float *flow_l_min)
+{
+    const uint32_t head = s_edge_head.load(std::memory_order_acquire);
+    uint32_t tail = s_edge_tail.load(std::memory_order_relaxed);
+
+    int64_t span_start_us = s_last_edge_us;
+    uint32_t intervals = 0;
+    for (; tail != head; ++tail) {
+        const int64_t edge_us = s_edge_ring[tail & (FLOW_EDGE_RING_SIZE - 1)];
+        if (span_start_us == 0) {
+            span_start_us = edge_us;
         } else {
-            s_flow_l_min_ema = FLOW_EMA_ALPHA * raw_flow_l_min
-                             + (1.0f - FLOW_EMA_ALPHA) * s_flow_l_min_ema;
+            intervals += 1;
         }
+        s_last_edge_us = edge_us;
+    }
+    s_edge_tail.store(tail, std::memory_order_release);
+
+    // Po preteceni je posledni hrana v ringu stara; mez podle ni by drzela
+    // prutok nizko, dokud cerpadlo bezi. Plati pocet pulzu a perioda se
+    // meri znovu od dalsich hran.
+    if (s_edge_overflow.exchange(false, std::memory_order_relaxed)) {
+        s_last_edge_us = 0;
+        s_period_flow_l_min = count_flow_l_min;
+        *flow_l_min = count_flow_l_min;
+        return true;
+    }
+
+    if (s_last_edge_us == 0) {
+        return false;
+    }
 
-        const float total_volume_l =
-            static_cast<float>(s_total_pulses) / static_cast<float>(FLOW_PULSES_PER_LITER);
-
-        sample_counter += 1;
-        if (sample_counter >= FLOW_LOG_EVERY_N_SAMPLES) {
-            sample_counter = 0;
-            ESP_LOGI(TAG,
-                     "Prutok raw=%.2f l/min, ema=%.2f l/min, celkem=%.2f l",
-                     raw_flow_l_min,
-                     s_flow_l_min_ema,
-                     total_volume_l);
+    if (intervals > 0 && s_last_edge_us > span_start_us) {
+        s_period_flow_l_min = (static_cast<float>(intervals) * 60000000.0f)
+                            / (static_cast<float>(s_last_edge_us - span_start_us)
+                               * static_cast<float>(s_pulses_per_liter));
+    }
+
+    const int64_t since_last_edge_us = now_us - s_last_edge_us;
+    if (since_last_edge_us > FLOW_PERIOD_TIMEOUT_US) {
+        s_period_flow_l_min = 0.0f;
+    } else if (since_last_edge_us > 0) {
+        const float bound_l_min = 60000000.0f
+                                / (static_cast<float>(since_last_edge_us) * static_cast<float>(s_pulses_per_liter));
+        if (bound_l_min < s_period_flow_l_min) {
+            s_period_flow_l_min = bound_l_min;
         }
+    }
+
+    *flow_l_min = s_period_flow_l_min;
+    return true;
+}
+
+// Vzorkovaci uloha planovace, spousti se kazdych flow_sample_ms
+static void pocitani_pulsu(void *arg)
+{
+    const int64_t now_us = esp_timer_get_time();
+    const int64_t elapsed_us = now_us - s_previous_sample_us;
+    s_previous_sample_us = now_us;
+
+    const uint32_t current_pulse_count = flow_pulse_count();
+    const uint32_t new_pulses = current_pulse_count - s_previous_pulse_count;
+    s_previous_pulse_count = current_pulse_count;
+
+    s_total_pulses += new_pulses;
+//        ESP_LOGI(TAG, "Nové pulzy: %lu, Celkem pulzů: %llu, Elapsed: %lld us",
+  //               new_pulses,
+    //             (unsigned long long)s_total_pulses,
+      //           (long long)elapsed_us);
+
+    const uint64_t target_persisted_steps =
+        s_flow_scale.origin_steps + (s_total_pulses - s_scale_origin_pulses) / s_pulses_per_step;
+    if (s_requested_counter_steps < target_persisted_steps) {
+        flow_persist_request(static_cast<uint32_t>(target_persisted_steps - s_requested_counter_steps));
+        s_requested_counter_steps = target_persisted_steps;
+    }
+
+    float raw_flow_l_min = 0.0f;
+    if (elapsed_us > 0) {
+        raw_flow_l_min = (static_cast<float>(new_pulses) * 60000000.0f)
+                       / (static_cast<float>(elapsed_us) * static_cast<float>(s_pulses_per_liter));
+    }
+
+    float period_flow_l_min = 0.0f;
+    if (s_period_mode && raw_flow_l_min > FLOW_PERIOD_MODE_EXIT_L_MIN) {
+        // Skok z klidu na velky prutok - pocet pulzu staci a perioda by
+        // jen dobihala, rezim se nize hned prepne zpet
+        s_flow_l_min_ema = raw_flow_l_min;
+        s_flow_ema_initialized = true;
+    } else if (s_period_mode && flow_period_sample(now_us, raw_flow_l_min, &period_flow_l_min)) {
+        // Perioda uz je prumerem pres hrany, EMA by ji jen zpozdila
+        s_flow_l_min_ema = period_flow_l_min;
+        s_flow_ema_initialized = true;
+    } else if (!s_flow_ema_initialized) {
+        s_flow_l_min_ema = raw_flow_l_min;
+        s_flow_ema_initialized = true;
+    } else {
+        s_flow_l_min_ema = FLOW_EMA_ALPHA * raw_flow_l_min
+                         + (1.0f - FLOW_EMA_ALPHA) * s_flow_l_min_ema;
+    }
+
+    // Hystereze mezi rezimy, aby se na hranici neprepinalo sem a tam
+    if (s_flow_l_min_ema < FLOW_PERIOD_MODE_ENTER_L_MIN) {
+        flow_period_mode_set(true, s_flow_l_min_ema);
+    } else if (s_flow_l_min_ema > FLOW_PERIOD_MODE_EXIT_L_MIN) {
+        flow_period_mode_set(false, s_flow_l_min_ema);
+    }
+
+    flow_rtc_save(now_us);
+
+    const float total_volume_l =
+        static_cast<float>(s_total_pulses) / static_cast<float>(s_pulses_per_liter);
+
+    s_sample_counter += 1;
+    if (s_sample_counter >= FLOW_LOG_EVERY_N_SAMPLES) {
+        s_sample_counter = 0;
+        ESP_LOGI(TAG,
+                 "Prutok raw=%.2f l/min, ema=%.2f l/min, celkem=%.2f l",
+                 raw_flow_l_min,
+                 s_flow_l_min_ema,
+                 total_volume_l);
+    }
 
-        app_event_t event = {
-            .event_type = EVT_SENSOR,
-            .timestamp_us = esp_timer_get_time(),
-            .data = {
-                .sensor = {
-                    .sensor_type = SENSOR_EVENT_FLOW,
-                    .data = {
-                        .flow = {
-                            .flow_l_min = s_flow_l_min_ema,
-                            .total_volume_l = total_volume_l,
-                        },
+    app_event_t event = {
+        .event_type = EVT_SENSOR,
+        .timestamp_us = esp_timer_get_time(),
+        .data = {
+            .sensor = {
+                .sensor_type = SENSOR_EVENT_FLOW,
+                .data = {
+                    .flow = {
+                        .flow_l_min = s_flow_l_min_ema,
+                        .total_volume_l = total_volume_l,
                     },
                 },
             },
-        };
+        },
+    };
 
-        if (!sensor_events_publish(&event, pdMS_TO_TICKS(20))) {
-            ESP_LOGW(TAG, "Fronta sensor eventu je plna, prutok zahozen");
-        }
+    if (!sensor_events_publish(&event)) {
+        ESP_LOGW(TAG, "Fronta odberatele sensor eventu je plna, prutok zahozen");
     }
 }
 
-void prutokomer_init(void)
+config_group_t prutokomer_get_config_group(void)
+{
+    config_group_t group = {
+        .items = FLOW_CONFIG_ITEMS,
+        .item_count = sizeof(FLOW_CONFIG_ITEMS) / sizeof(FLOW_CONFIG_ITEMS[0]),
+    };
+    return group;
+}
+
+static void load_flow_config(int32_t *step_liters, int32_t *sample_period_ms)
 {
+    int32_t pulses_per_liter = FLOW_DEFAULT_PULSES_PER_LITER;
+    int32_t flash_cycles = FLOW_DEFAULT_FLASH_CYCLES;
+    ESP_ERROR_CHECK(config_webapp_get_i32("flow_pulses_l", &pulses_per_liter));
+    ESP_ERROR_CHECK(config_webapp_get_i32("flow_step_l", step_liters));
+    ESP_ERROR_CHECK(config_webapp_get_i32("flash_cycles", &flash_cycles));
+    ESP_ERROR_CHECK(config_webapp_get_i32("flow_sample_ms", sample_period_ms));
+    s_pulses_per_liter = static_cast<uint32_t>(pulses_per_liter > 0 ? pulses_per_liter : FLOW_DEFAULT_PULSES_PER_LITER);
+    s_flash_rated_cycles = static_cast<uint32_t>(flash_cycles > 0 ? flash_cycles : FLOW_DEFAULT_FLASH_CYCLES);
+    if (*step_liters <= 0) {
+        *step_liters = FLOW_DEFAULT_STEP_LITERS;
+    }
+    if (*sample_period_ms <= 0) {
+        *sample_period_ms = FLOW_DEFAULT_SAMPLE_PERIOD_MS;
+    }
+}
 
+void prutokomer_init(void)
+{
+    int32_t step_liters = FLOW_DEFAULT_STEP_LITERS;
+    int32_t sample_period_ms = FLOW_DEFAULT_SAMPLE_PERIOD_MS;
+    load_flow_config(&step_liters, &sample_period_ms);
 
     ESP_ERROR_CHECK(s_flow_counter.init(FLOW_COUNTER_PARTITION_LABEL));
 
     // ESP_ERROR_CHECK(s_flow_counter.reset());
 
-    s_persisted_counter_steps = s_flow_counter.value();
-    s_total_pulses = s_persisted_counter_steps * static_cast<uint64_t>(PULSES_PER_COUNTER_INCREMENT);
+    s_requested_counter_steps = s_flow_counter.value();
+    flow_counter_snapshot();
+    ESP_ERROR_CHECK(flow_scale_load(static_cast<uint32_t>(step_liters), s_requested_counter_steps));
+    s_scale_origin_pulses = s_flow_scale.origin_liters * s_pulses_per_liter;
+    s_pulses_per_step = static_cast<uint64_t>(s_flow_scale.liters_per_step) * s_pulses_per_liter;
+
+    s_total_pulses = flow_steps_to_liters(s_requested_counter_steps) * s_pulses_per_liter;
+    // Kroky, ktere se pred resetem nestihly zapsat, si vyzada prvni vzorek
+    flow_rtc_restore(s_requested_counter_steps);
     
     ESP_LOGW(TAG,
-             "Flow counter inicializovan, kroky=%llu, start_pulsy=%llu, objem=%llu l",
-             (unsigned long long)s_persisted_counter_steps,
+             "Flow counter inicializovan, kroky=%llu (%lu l), start_pulsy=%llu, objem=%llu l",
+             (unsigned long long)s_requested_counter_steps,
+             (unsigned long)s_flow_scale.liters_per_step,
              (unsigned long long)s_total_pulses,
-             (unsigned long long)(s_persisted_counter_steps * COUNTER_INCREMENT_LITERS));
-    //TODO Někam to nastavit ..
+             (unsigned long long)flow_steps_to_liters(s_requested_counter_steps));
 
-    // --- Nastavení GPIO pro flow senzor ---
-    gpio_config_t io_conf = {
-        .pin_bit_mask = 1ULL << FLOW_GPIO,
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_POSEDGE
-    };
-    gpio_config(&io_conf);
+    if (xTaskCreate(flow_persist_task, "flow_persist", FLOW_PERSIST_TASK_STACK_SIZE, NULL,
+                    FLOW_PERSIST_TASK_PRIORITY, &s_persist_task) != pdPASS) {
+        ESP_LOGE(TAG, "Nelze spustit task pro zapis flow counteru");
+        return;
+    }
+    diag_publisher_register(flow_persist_diag);
+    diag_publisher_register(flow_wear_diag);
 
-    gpio_install_isr_service(0);
-    gpio_isr_handler_add(FLOW_GPIO, flow_isr_handler, NULL);
+    const esp_err_t counter_result = flow_pulse_counter_init();
+    if (counter_result != ESP_OK) {
+        ESP_LOGE(TAG, "Nelze spustit citac pulzu: %s", esp_err_to_name(counter_result));
+        return;
+    }
 
     ESP_LOGI(TAG, "Startuji měření pulzů...");
 
-    xTaskCreate(pocitani_pulsu, "pocitani_pulsu", FLOW_TASK_STACK_SIZE, NULL, 1, NULL);
+    s_previous_pulse_count = flow_pulse_count();
+    s_previous_sample_us = esp_timer_get_time();
+    if (tick_scheduler_add_job("pocitani_pulsu", static_cast<uint32_t>(sample_period_ms), pocitani_pulsu, NULL) == nullptr) {
+        ESP_LOGE(TAG, "Nelze naplanovat mereni prutoku");
+    }
 }
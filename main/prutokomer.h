@@ -1,3 +1,6 @@
 #pragma once
 
+#include "config_webapp.h"
+
 void prutokomer_init(void);
+config_group_t prutokomer_get_config_group(void);
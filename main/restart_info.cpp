@@ -5,18 +5,24 @@
 #include "esp_log.h"
 #include "nvs.h"
 
+#include "flash_counter_store.h"
+
 static const char *TAG = "RESTART_INFO";
 static const char *SYS_NAMESPACE = "sys_meta";
 static const char *SYS_BOOT_COUNT_KEY = "boot_count";
 static const char *SYS_LAST_REASON_KEY = "last_reason";
 static const char *SYS_LAST_TIME_KEY = "last_time";
+static const char *COUNTER_PARTITION_LABEL = "user_data1";
 
-esp_err_t app_restart_info_update_and_load(app_restart_info_t *out_info)
-{
-    if (out_info == nullptr) {
-        return ESP_ERR_INVALID_ARG;
-    }
+// Trvale citace systemu; dalsi kanaly (energie, motohodiny cerpadla) se pridaji
+// sem pred init
+static FlashCounterStore s_counters;
+static size_t s_boot_count_channel = 0;
 
+// Pocet startu byl driv v NVS a prepisoval se pri kazdem bootu. Citac hodnotu
+// prevezme (opakovani po vypadku nic nezdvoji) a klice se smazou.
+static esp_err_t migrate_nvs_boot_count(void)
+{
     nvs_handle_t nvs_handle;
     esp_err_t result = nvs_open(SYS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (result != ESP_OK) {
@@ -25,11 +31,62 @@ esp_err_t app_restart_info_update_and_load(app_restart_info_t *out_info)
 
     uint32_t boot_count = 0;
     result = nvs_get_u32(nvs_handle, SYS_BOOT_COUNT_KEY, &boot_count);
-    if (result != ESP_OK && result != ESP_ERR_NVS_NOT_FOUND) {
+    if (result == ESP_ERR_NVS_NOT_FOUND) {
         nvs_close(nvs_handle);
+        return ESP_OK;
+    }
+
+    if (result == ESP_OK) {
+        const uint64_t stored = s_counters.value(s_boot_count_channel);
+        if (stored < boot_count) {
+            s_counters.add(s_boot_count_channel, boot_count - stored);
+            result = s_counters.flush();
+        }
+    }
+    if (result == ESP_OK) {
+        ESP_LOGW(TAG, "Pocet startu %lu prevzat z NVS", static_cast<unsigned long>(boot_count));
+        nvs_erase_key(nvs_handle, SYS_LAST_REASON_KEY);
+        nvs_erase_key(nvs_handle, SYS_LAST_TIME_KEY);
+        result = nvs_erase_key(nvs_handle, SYS_BOOT_COUNT_KEY);
+    }
+    if (result == ESP_OK) {
+        result = nvs_commit(nvs_handle);
+    }
+
+    nvs_close(nvs_handle);
+    return result;
+}
+
+static esp_err_t boot_count_increment(uint32_t *boot_count)
+{
+    esp_err_t result = s_counters.add_channel("boot_count", 1, &s_boot_count_channel);
+    if (result != ESP_OK) {
+        return result;
+    }
+    result = s_counters.init(COUNTER_PARTITION_LABEL);
+    if (result != ESP_OK) {
+        return result;
+    }
+    result = migrate_nvs_boot_count();
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    s_counters.add(s_boot_count_channel, 1);
+    result = s_counters.flush();
+    if (result != ESP_OK) {
         return result;
     }
-    boot_count++;
+
+    *boot_count = static_cast<uint32_t>(s_counters.value(s_boot_count_channel));
+    return ESP_OK;
+}
+
+esp_err_t app_restart_info_update_and_load(app_restart_info_t *out_info)
+{
+    if (out_info == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
     esp_reset_reason_t reason = esp_reset_reason();
     int64_t now = static_cast<int64_t>(time(nullptr));
@@ -37,21 +94,21 @@ esp_err_t app_restart_info_update_and_load(app_restart_info_t *out_info)
         now = 0;
     }
 
-    ESP_ERROR_CHECK(nvs_set_u32(nvs_handle, SYS_BOOT_COUNT_KEY, boot_count));
-    ESP_ERROR_CHECK(nvs_set_i32(nvs_handle, SYS_LAST_REASON_KEY, static_cast<int32_t>(reason)));
-    ESP_ERROR_CHECK(nvs_set_i64(nvs_handle, SYS_LAST_TIME_KEY, now));
-    ESP_ERROR_CHECK(nvs_commit(nvs_handle));
-    nvs_close(nvs_handle);
-
-    out_info->boot_count = boot_count;
+    // Duvod a cas plati i bez citace; pocet startu 0 = neznamy
+    out_info->boot_count = 0;
     out_info->last_reason = reason;
     out_info->last_restart_unix = now;
 
+    esp_err_t result = boot_count_increment(&out_info->boot_count);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Citac startu nelze aktualizovat: %s", esp_err_to_name(result));
+    }
+
     ESP_LOGI(TAG,
              "Restart metadata updated: count=%lu reason=%d time=%lld",
-             static_cast<unsigned long>(boot_count),
+             static_cast<unsigned long>(out_info->boot_count),
              static_cast<int>(reason),
              static_cast<long long>(now));
 
-    return ESP_OK;
+    return result;
 }
@@ -10,4 +10,8 @@ typedef struct {
     int64_t last_restart_unix;
 } app_restart_info_t;
 
+/**
+ * Zapocte start a vrati metadata restartu. Pri chybe citace ve flash je
+ * out_info presto vyplneno (boot_count = 0, neznamy) a chyba se jen vraci.
+ */
 esp_err_t app_restart_info_update_and_load(app_restart_info_t *out_info);
@@ -1,12 +1,51 @@
 #include "sensor_events.h"
 
+#include <atomic>
 #include <stdio.h>
 
 #include "esp_log.h"
+#include "event_trace.h"
+#include "esp_timer.h"
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+// Odkladaci kruh ridicich eventu, ktere se nevesly do fronty odberatele
+static constexpr size_t CONTROL_OVERFLOW_LENGTH = 8;
+
+struct sensor_events_subscriber {
+    const char *name;
+    uint32_t topic_mask;
+    uint32_t latest_mask;
+    QueueHandle_t queues[EVENT_LANE_COUNT];
+    SemaphoreHandle_t doorbell;                 // probouzi odberatele pri nove hodnote/zprave
+    std::atomic<uint32_t> latest_pending;       // kanaly s neprevzatou posledni hodnotou
+    uint32_t latest_delivered_sequence[EVENT_TOPIC_COUNT];
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> overwritten[EVENT_TOPIC_COUNT];
+    app_event_t control_overflow[CONTROL_OVERFLOW_LENGTH];  // chrani s_overflow_lock
+    size_t overflow_head;
+    size_t overflow_count;
+};
+
+// Schranka s posledni hodnotou kanalu - prepisuje se na miste
+typedef struct {
+    app_event_t event;
+    uint32_t sequence;
+} latest_slot_t;
 
 static const char *TAG = "SENSOR_EVENTS";
-static QueueHandle_t s_sensor_events_queue = nullptr;
+static sensor_events_subscriber_t s_subscribers[SENSOR_EVENTS_MAX_SUBSCRIBERS];
+static std::atomic<size_t> s_subscriber_count{0};
+static portMUX_TYPE s_subscribe_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE s_overflow_lock = portMUX_INITIALIZER_UNLOCKED;
+static latest_slot_t s_latest[EVENT_TOPIC_COUNT];
+static portMUX_TYPE s_latest_lock = portMUX_INITIALIZER_UNLOCKED;
+static sensor_events_topic_stats_t s_topic_stats[EVENT_TOPIC_COUNT];
+static uint32_t s_lane_high_watermark[EVENT_LANE_COUNT];
+static uint32_t s_lane_capacity[EVENT_LANE_COUNT];
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_initialized = false;
 
 static const char *event_type_to_string(event_type_t event_type)
 {
@@ -22,35 +61,463 @@ static const char *event_type_to_string(event_type_t event_type)
     }
 }
 
-void sensor_events_init(size_t queue_length)
+static void stats_add(event_topic_t topic, uint32_t published, uint32_t dropped, uint32_t coalesced)
 {
-    if (s_sensor_events_queue != nullptr) {
-        return;
+    taskENTER_CRITICAL(&s_stats_lock);
+    sensor_events_topic_stats_t &stats = s_topic_stats[topic];
+    stats.published += published;
+    stats.dropped += dropped;
+    stats.coalesced += coalesced;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void stats_record_queue_depth(event_lane_t lane, QueueHandle_t queue)
+{
+    const uint32_t waiting = uxQueueMessagesWaiting(queue);
+    taskENTER_CRITICAL(&s_stats_lock);
+    if (waiting > s_lane_high_watermark[lane]) {
+        s_lane_high_watermark[lane] = waiting;
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void stats_record_received(const app_event_t *event)
+{
+    const event_topic_t topic = sensor_event_topic(event);
+    const int64_t latency = esp_timer_get_time() - event->timestamp_us;
+    const uint32_t latency_us = latency <= 0 ? 0 : (latency > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(latency));
+
+    const uint32_t latency_ms = latency_us / 1000;
+    size_t bucket = 0;
+    while (bucket < SENSOR_EVENTS_LATENCY_BUCKETS - 1 && latency_ms >= (1UL << bucket)) {
+        ++bucket;
+    }
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    sensor_events_topic_stats_t &stats = s_topic_stats[topic];
+    stats.received += 1;
+    stats.latency_sum_us += latency_us;
+    if (latency_us > stats.latency_max_us) {
+        stats.latency_max_us = latency_us;
+    }
+    stats.latency_histogram[bucket] += 1;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static uint32_t store_latest(event_topic_t topic, const app_event_t *event)
+{
+    taskENTER_CRITICAL(&s_latest_lock);
+    latest_slot_t &slot = s_latest[topic];
+    slot.event = *event;
+    slot.sequence += 1;
+    if (slot.sequence == 0) {
+        slot.sequence = 1;  // 0 je vyhrazena pro "zatim nic"
+    }
+    const uint32_t sequence = slot.sequence;
+    taskEXIT_CRITICAL(&s_latest_lock);
+    return sequence;
+}
+
+static uint32_t load_latest(event_topic_t topic, app_event_t *event)
+{
+    taskENTER_CRITICAL(&s_latest_lock);
+    const latest_slot_t &slot = s_latest[topic];
+    *event = slot.event;
+    const uint32_t sequence = slot.sequence;
+    taskEXIT_CRITICAL(&s_latest_lock);
+    return sequence;
+}
+
+/**
+ * Ulozi ridici event do odkladaciho kruhu odberatele.
+ * @param only_if_overflowing true = jen kdyz uz v kruhu neco ceka
+ * @param stored vystup - event byl ulozen
+ * @return false pokud je kruh plny (event je ztracen)
+ */
+static bool overflow_push(sensor_events_subscriber_t *subscriber, const app_event_t *event,
+                          bool only_if_overflowing, bool *stored)
+{
+    bool has_room = true;
+    *stored = false;
+    taskENTER_CRITICAL(&s_overflow_lock);
+    if (!only_if_overflowing || subscriber->overflow_count > 0) {
+        if (subscriber->overflow_count < CONTROL_OVERFLOW_LENGTH) {
+            const size_t tail = (subscriber->overflow_head + subscriber->overflow_count) % CONTROL_OVERFLOW_LENGTH;
+            subscriber->control_overflow[tail] = *event;
+            subscriber->overflow_count += 1;
+            *stored = true;
+        } else {
+            has_room = false;
+        }
+    }
+    taskEXIT_CRITICAL(&s_overflow_lock);
+    return has_room;
+}
+
+static bool overflow_pop(sensor_events_subscriber_t *subscriber, app_event_t *event)
+{
+    bool taken = false;
+    taskENTER_CRITICAL(&s_overflow_lock);
+    if (subscriber->overflow_count > 0) {
+        *event = subscriber->control_overflow[subscriber->overflow_head];
+        subscriber->overflow_head = (subscriber->overflow_head + 1) % CONTROL_OVERFLOW_LENGTH;
+        subscriber->overflow_count -= 1;
+        taken = true;
+    }
+    taskEXIT_CRITICAL(&s_overflow_lock);
+    return taken;
+}
+
+static bool take_pending_latest(sensor_events_subscriber_t *subscriber, uint32_t mask, app_event_t *event)
+{
+    uint32_t pending = subscriber->latest_pending.load(std::memory_order_acquire) & mask;
+    while (pending != 0) {
+        const uint32_t bit = pending & (~pending + 1);
+        const uint32_t previous_pending = subscriber->latest_pending.fetch_and(~bit, std::memory_order_acq_rel);
+        pending = previous_pending & mask & ~bit;
+        if ((previous_pending & bit) == 0) {
+            continue;
+        }
+
+        const event_topic_t topic = static_cast<event_topic_t>(__builtin_ctz(bit));
+        const uint32_t sequence = load_latest(topic, event);
+        const uint32_t previous = subscriber->latest_delivered_sequence[topic];
+        if (previous != 0 && sequence - previous > 1) {
+            subscriber->overwritten[topic].fetch_add(sequence - previous - 1, std::memory_order_relaxed);
+            stats_add(topic, 0, 0, sequence - previous - 1);
+        }
+        subscriber->latest_delivered_sequence[topic] = sequence;
+        return true;
+    }
+    return false;
+}
+
+void sensor_events_init(void)
+{
+    s_initialized = true;
+}
+
+sensor_events_subscriber_t *sensor_events_subscribe(const sensor_events_subscriber_config_t *config)
+{
+    if (!s_initialized || config == nullptr) {
+        return nullptr;
+    }
+
+    const uint32_t latest_mask = config->latest_mask & EVENT_TOPIC_ALL;
+    const uint32_t topic_mask = config->topic_mask & EVENT_TOPIC_ALL & ~latest_mask;
+    if ((topic_mask | latest_mask) == 0) {
+        return nullptr;
+    }
+
+    const size_t lane_lengths[EVENT_LANE_COUNT] = {
+        config->control_queue_length,
+        config->queue_length,
+    };
+    uint32_t lane_masks[EVENT_LANE_COUNT] = {};
+    for (size_t topic = 0; topic < EVENT_TOPIC_COUNT; ++topic) {
+        if ((topic_mask & EVENT_TOPIC_BIT(topic)) != 0) {
+            lane_masks[sensor_event_topic_lane(static_cast<event_topic_t>(topic))] |= EVENT_TOPIC_BIT(topic);
+        }
+    }
+
+    QueueHandle_t queues[EVENT_LANE_COUNT] = {};
+    bool queues_ok = true;
+    for (size_t lane = 0; lane < EVENT_LANE_COUNT; ++lane) {
+        if (lane_masks[lane] == 0) {
+            continue;
+        }
+        if (lane_lengths[lane] == 0) {
+            queues_ok = false;
+            break;
+        }
+        queues[lane] = xQueueCreate(lane_lengths[lane], sizeof(app_event_t));
+        if (queues[lane] == nullptr) {
+            queues_ok = false;
+            break;
+        }
+    }
+    SemaphoreHandle_t doorbell = queues_ok ? xSemaphoreCreateBinary() : nullptr;
+    if (doorbell == nullptr) {
+        ESP_LOGE(TAG, "Nelze vytvorit fronty odberatele %s", config->name != nullptr ? config->name : "?");
+        for (size_t lane = 0; lane < EVENT_LANE_COUNT; ++lane) {
+            if (queues[lane] != nullptr) {
+                vQueueDelete(queues[lane]);
+            }
+        }
+        return nullptr;
+    }
+
+    sensor_events_subscriber_t *subscriber = nullptr;
+    taskENTER_CRITICAL(&s_subscribe_lock);
+    const size_t index = s_subscriber_count.load(std::memory_order_relaxed);
+    if (index < SENSOR_EVENTS_MAX_SUBSCRIBERS) {
+        subscriber = &s_subscribers[index];
+        subscriber->name = config->name;
+        subscriber->topic_mask = topic_mask;
+        subscriber->latest_mask = latest_mask;
+        for (size_t lane = 0; lane < EVENT_LANE_COUNT; ++lane) {
+            subscriber->queues[lane] = queues[lane];
+        }
+        subscriber->doorbell = doorbell;
+        subscriber->latest_pending.store(0, std::memory_order_relaxed);
+        subscriber->dropped.store(0, std::memory_order_relaxed);
+        subscriber->overflow_head = 0;
+        subscriber->overflow_count = 0;
+        for (size_t topic = 0; topic < EVENT_TOPIC_COUNT; ++topic) {
+            subscriber->latest_delivered_sequence[topic] = 0;
+            subscriber->overwritten[topic].store(0, std::memory_order_relaxed);
+        }
+        for (size_t lane = 0; lane < EVENT_LANE_COUNT; ++lane) {
+            if (queues[lane] != nullptr && lane_lengths[lane] > s_lane_capacity[lane]) {
+                s_lane_capacity[lane] = lane_lengths[lane];
+            }
+        }
+        // publikace cte pocet s acquire, takze vidi uz plne vyplneny zaznam
+        s_subscriber_count.store(index + 1, std::memory_order_release);
+    }
+    taskEXIT_CRITICAL(&s_subscribe_lock);
+
+    if (subscriber == nullptr) {
+        ESP_LOGE(TAG, "Prekrocen maximalni pocet odberatelu (%d)", SENSOR_EVENTS_MAX_SUBSCRIBERS);
+        for (size_t lane = 0; lane < EVENT_LANE_COUNT; ++lane) {
+            if (queues[lane] != nullptr) {
+                vQueueDelete(queues[lane]);
+            }
+        }
+        vSemaphoreDelete(doorbell);
+        return nullptr;
+    }
+
+    ESP_LOGI(TAG,
+             "Odberatel %s zaregistrovan: topics=0x%02lx latest=0x%02lx fronta=%u ridici=%u",
+             subscriber->name != nullptr ? subscriber->name : "?",
+             (unsigned long)subscriber->topic_mask,
+             (unsigned long)subscriber->latest_mask,
+             (unsigned)(lane_masks[EVENT_LANE_TELEMETRY] != 0 ? config->queue_length : 0),
+             (unsigned)(lane_masks[EVENT_LANE_CONTROL] != 0 ? config->control_queue_length : 0));
+    return subscriber;
+}
+
+bool sensor_events_publish(const app_event_t *event)
+{
+    if (event == nullptr) {
+        return false;
+    }
+
+    const event_topic_t topic = sensor_event_topic(event);
+    const uint32_t topic_bit = EVENT_TOPIC_BIT(topic);
+    const event_lane_t lane = sensor_event_topic_lane(topic);
+    const size_t subscriber_count = s_subscriber_count.load(std::memory_order_acquire);
+    bool delivered_to_all = true;
+
+    event_trace_record(event);
+    store_latest(topic, event);
+    stats_add(topic, 1, 0, 0);
+
+    for (size_t index = 0; index < subscriber_count; ++index) {
+        sensor_events_subscriber_t &subscriber = s_subscribers[index];
+
+        if ((subscriber.latest_mask & topic_bit) != 0) {
+            // Slucovani: odberatel si pri prevzeti vezme jen nejnovejsi hodnotu
+            const uint32_t previous = subscriber.latest_pending.fetch_or(topic_bit, std::memory_order_acq_rel);
+            if ((previous & topic_bit) == 0) {
+                xSemaphoreGive(subscriber.doorbell);
+            }
+            continue;
+        }
+
+        if ((subscriber.topic_mask & topic_bit) == 0) {
+            continue;
+        }
+
+        // Stavove prechody se nesmi ztratit ani prehazet: dokud v odkladacim
+        // kruhu neco ceka, jdou dalsi ridici eventy za to, ne do fronty
+        bool stored = false;
+        bool has_room = true;
+        if (lane == EVENT_LANE_CONTROL) {
+            has_room = overflow_push(&subscriber, event, true, &stored);
+        }
+
+        // Bez cekani - plna fronta jednoho odberatele nesmi zdrzet ostatni
+        if (has_room && !stored && xQueueSend(subscriber.queues[lane], event, 0) == pdTRUE) {
+            stats_record_queue_depth(lane, subscriber.queues[lane]);
+            xSemaphoreGive(subscriber.doorbell);
+            continue;
+        }
+
+        if (has_room && !stored && lane == EVENT_LANE_CONTROL) {
+            has_room = overflow_push(&subscriber, event, false, &stored);
+        }
+        if (stored) {
+            xSemaphoreGive(subscriber.doorbell);
+            continue;
+        }
+
+        subscriber.dropped.fetch_add(1, std::memory_order_relaxed);
+        stats_add(topic, 0, 1, 0);
+        delivered_to_all = false;
     }
 
-    s_sensor_events_queue = xQueueCreate(queue_length, sizeof(app_event_t));
-    if (s_sensor_events_queue == nullptr) {
-        ESP_LOGE(TAG, "Nelze vytvorit frontu sensor eventu");
-        abort();
+    return delivered_to_all;
+}
+
+static bool receive_next(sensor_events_subscriber_t *subscriber, app_event_t *event, TickType_t timeout)
+{
+    const TickType_t start = xTaskGetTickCount();
+    while (true) {
+        QueueHandle_t control = subscriber->queues[EVENT_LANE_CONTROL];
+        if (control != nullptr && xQueueReceive(control, event, 0) == pdTRUE) {
+            return true;
+        }
+        // odlozene ridici eventy jsou novejsi nez vse ve fronte
+        if (overflow_pop(subscriber, event)) {
+            return true;
+        }
+        QueueHandle_t telemetry = subscriber->queues[EVENT_LANE_TELEMETRY];
+        if (telemetry != nullptr && xQueueReceive(telemetry, event, 0) == pdTRUE) {
+            return true;
+        }
+        if (take_pending_latest(subscriber, subscriber->latest_mask, event)) {
+            return true;
+        }
+
+        TickType_t wait = portMAX_DELAY;
+        if (timeout != portMAX_DELAY) {
+            const TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= timeout) {
+                return false;
+            }
+            wait = timeout - elapsed;
+        }
+
+        // Zvonek muze byt dan i bez nove zpravy (uz prevzate drive) - pak jen znovu zkontrolujeme
+        if (xSemaphoreTake(subscriber->doorbell, wait) != pdTRUE && timeout != portMAX_DELAY) {
+            return false;
+        }
     }
 }
 
-bool sensor_events_publish(const app_event_t *event, TickType_t timeout)
+bool sensor_events_receive(sensor_events_subscriber_t *subscriber, app_event_t *event, TickType_t timeout)
 {
-    if (s_sensor_events_queue == nullptr || event == nullptr) {
+    if (subscriber == nullptr || event == nullptr) {
         return false;
     }
 
-    return xQueueSend(s_sensor_events_queue, event, timeout) == pdTRUE;
+    if (!receive_next(subscriber, event, timeout)) {
+        return false;
+    }
+
+    stats_record_received(event);
+    return true;
+}
+
+uint32_t sensor_events_subscriber_dropped(const sensor_events_subscriber_t *subscriber)
+{
+    if (subscriber == nullptr) {
+        return 0;
+    }
+
+    return subscriber->dropped.load(std::memory_order_relaxed);
+}
+
+uint32_t sensor_events_subscriber_overwritten(const sensor_events_subscriber_t *subscriber, event_topic_t topic)
+{
+    if (subscriber == nullptr || topic >= EVENT_TOPIC_COUNT) {
+        return 0;
+    }
+
+    return subscriber->overwritten[topic].load(std::memory_order_relaxed);
 }
 
-bool sensor_events_receive(app_event_t *event, TickType_t timeout)
+bool sensor_events_get_latest(event_topic_t topic, app_event_t *event, uint32_t *sequence)
 {
-    if (s_sensor_events_queue == nullptr || event == nullptr) {
+    if (topic >= EVENT_TOPIC_COUNT || event == nullptr) {
         return false;
     }
 
-    return xQueueReceive(s_sensor_events_queue, event, timeout) == pdTRUE;
+    const uint32_t current = load_latest(topic, event);
+    if (sequence != nullptr) {
+        *sequence = current;
+    }
+    return current != 0;
+}
+
+void sensor_events_get_topic_stats(event_topic_t topic, sensor_events_topic_stats_t *stats)
+{
+    if (topic >= EVENT_TOPIC_COUNT || stats == nullptr) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    *stats = s_topic_stats[topic];
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+uint32_t sensor_events_queue_high_watermark(event_lane_t lane, uint32_t *capacity)
+{
+    if (lane >= EVENT_LANE_COUNT) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    const uint32_t high_watermark = s_lane_high_watermark[lane];
+    const uint32_t lane_capacity = s_lane_capacity[lane];
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    if (capacity != nullptr) {
+        *capacity = lane_capacity;
+    }
+    return high_watermark;
+}
+
+event_topic_t sensor_event_topic(const app_event_t *event)
+{
+    switch (event->event_type) {
+        case EVT_SENSOR:
+            switch (event->data.sensor.sensor_type) {
+                case SENSOR_EVENT_LEVEL:
+                    return EVENT_TOPIC_LEVEL;
+                case SENSOR_EVENT_FLOW:
+                    return EVENT_TOPIC_FLOW;
+                case SENSOR_EVENT_TEMPERATURE:
+                default:
+                    return EVENT_TOPIC_TEMPERATURE;
+            }
+        case EVT_NETWORK:
+            return EVENT_TOPIC_NETWORK;
+        case EVT_TICK:
+        default:
+            return EVENT_TOPIC_TICK;
+    }
+}
+
+event_lane_t sensor_event_topic_lane(event_topic_t topic)
+{
+    switch (topic) {
+        case EVENT_TOPIC_NETWORK:
+        case EVENT_TOPIC_TICK:
+            return EVENT_LANE_CONTROL;
+        default:
+            return EVENT_LANE_TELEMETRY;
+    }
+}
+
+const char *sensor_event_topic_name(event_topic_t topic)
+{
+    switch (topic) {
+        case EVENT_TOPIC_TEMPERATURE:
+            return "temperature";
+        case EVENT_TOPIC_LEVEL:
+            return "level";
+        case EVENT_TOPIC_FLOW:
+            return "flow";
+        case EVENT_TOPIC_NETWORK:
+            return "network";
+        case EVENT_TOPIC_TICK:
+            return "tick";
+        default:
+            return "unknown";
+    }
 }
 
 void sensor_event_to_string(const app_event_t *event, char *buffer, size_t buffer_len)
@@ -79,11 +546,12 @@ void sensor_event_to_string(const app_event_t *event, char *buffer, size_t buffe
                 case SENSOR_EVENT_LEVEL:
                     snprintf(buffer,
                              buffer_len,
-                             "event=%s type=level ts=%lld raw=%lu height=%.3fm",
+                             "event=%s type=level ts=%lld raw=%lu height=%.3fm volume=%.1fl",
                              event_type_to_string(event->event_type),
                              (long long)event->timestamp_us,
                              (unsigned long)event->data.sensor.data.level.raw_value,
-                             event->data.sensor.data.level.height_m);
+                             event->data.sensor.data.level.height_m,
+                             event->data.sensor.data.level.volume_l);
                     break;
 
                 case SENSOR_EVENT_FLOW:
@@ -35,6 +35,7 @@ typedef struct {
 typedef struct {
     uint32_t raw_value;
     float height_m;
+    float volume_l;     // NAN pokud tvar nadrze neni nastaven
 } sensor_level_data_t;
 
 typedef struct {
@@ -66,9 +67,100 @@ typedef struct {
     } data;
 } app_event_t;
 
-void sensor_events_init(size_t queue_length);
-bool sensor_events_publish(const app_event_t *event, TickType_t timeout);
-bool sensor_events_receive(app_event_t *event, TickType_t timeout);
+// Kanály (topiky) sběrnice - každý typ senzoru má vlastní kanál
+typedef enum {
+    EVENT_TOPIC_TEMPERATURE = 0,
+    EVENT_TOPIC_LEVEL,
+    EVENT_TOPIC_FLOW,
+    EVENT_TOPIC_NETWORK,
+    EVENT_TOPIC_TICK,
+    EVENT_TOPIC_COUNT
+} event_topic_t;
+
+#define EVENT_TOPIC_BIT(topic) (1UL << (topic))
+#define EVENT_TOPIC_ALL ((1UL << EVENT_TOPIC_COUNT) - 1UL)
+
+// Prioritni pruhy - ridici a sitove eventy maji vlastni vyhrazenou kapacitu
+// a odberatel je vzdy vybira prednostne pred telemetrii
+typedef enum {
+    EVENT_LANE_CONTROL = 0,
+    EVENT_LANE_TELEMETRY,
+    EVENT_LANE_COUNT
+} event_lane_t;
+
+#define SENSOR_EVENTS_MAX_SUBSCRIBERS 6
+
+// Histogram zpozdeni publikace -> prevzeti: kos i pocita zpozdeni < 2^i ms,
+// posledni kos vse ostatni
+#define SENSOR_EVENTS_LATENCY_BUCKETS 12
+
+typedef struct {
+    uint32_t published;      // publikovane eventy kanalu
+    uint32_t dropped;        // zahozene kvuli plne fronte (soucet pres odberatele)
+    uint32_t coalesced;      // prepsane v posledni hodnote drive, nez si je odberatel prevzal
+    uint32_t received;       // prevzate odberateli
+    uint32_t latency_max_us;
+    uint64_t latency_sum_us;
+    uint32_t latency_histogram[SENSOR_EVENTS_LATENCY_BUCKETS];
+} sensor_events_topic_stats_t;
+
+typedef struct sensor_events_subscriber sensor_events_subscriber_t;
+
+typedef struct {
+    const char *name;        // jmeno odberatele (pro logy)
+    uint32_t topic_mask;     // EVENT_TOPIC_BIT(...) kanalu dorucovanych pres frontu
+    uint32_t latest_mask;    // kanaly dorucovane jen jako posledni hodnota (slucovani)
+    size_t queue_length;     // delka fronty telemetrie (0 pokud zadny telemetricky kanal neodebira frontou)
+    size_t control_queue_length; // vyhrazena delka fronty ridicich eventu (0 pokud zadny neodebira)
+} sensor_events_subscriber_config_t;
+
+void sensor_events_init(void);
+
+/**
+ * Zaregistruje odberatele. Kazdy odberatel ma vlastni frontu, takze pomaly
+ * odberatel nikdy neblokuje ostatni ani producenta.
+ * @return handle odberatele nebo NULL pri chybe
+ */
+sensor_events_subscriber_t *sensor_events_subscribe(const sensor_events_subscriber_config_t *config);
+
+/**
+ * Rozesle event vsem odberatelum jeho kanalu. Nikdy neblokuje.
+ * @return false pokud event nekteremu odberateli nebylo mozne dorucit
+ */
+bool sensor_events_publish(const app_event_t *event);
+
+/**
+ * Prevezme dalsi event odberatele. Nejdrive vyprazdni ridici pruh, pak
+ * telemetrii. Kanaly z latest_mask vraci vzdy jen nejnovejsi hodnotu;
+ * mezilehle vzorky jsou prepsany a zapocteny do
+ * sensor_events_subscriber_overwritten().
+ *
+ * Kdyz se ridici event nevejde do vyhrazene fronty, odlozi se do maleho
+ * kruhu odberatele a doruci se v poradi za frontou. Teprve kdyz je plny
+ * i ten, event se zahodi a zapocte do sensor_events_subscriber_dropped().
+ */
+bool sensor_events_receive(sensor_events_subscriber_t *subscriber, app_event_t *event, TickType_t timeout);
+uint32_t sensor_events_subscriber_dropped(const sensor_events_subscriber_t *subscriber);
+uint32_t sensor_events_subscriber_overwritten(const sensor_events_subscriber_t *subscriber, event_topic_t topic);
+
+/**
+ * Precte posledni publikovanou hodnotu kanalu bez ohledu na odber.
+ * @param sequence volitelne poradove cislo hodnoty (0 = zatim nic nepublikovano)
+ * @return false pokud na kanalu jeste nic nebylo publikovano
+ */
+bool sensor_events_get_latest(event_topic_t topic, app_event_t *event, uint32_t *sequence);
+
+void sensor_events_get_topic_stats(event_topic_t topic, sensor_events_topic_stats_t *stats);
+
+/**
+ * Nejvyssi zaznamenane zaplneni fronty pruhu pres vsechny odberatele.
+ * @param capacity volitelne - nejvetsi delka fronty pruhu
+ */
+uint32_t sensor_events_queue_high_watermark(event_lane_t lane, uint32_t *capacity);
+
+event_topic_t sensor_event_topic(const app_event_t *event);
+event_lane_t sensor_event_topic_lane(event_topic_t topic);
+const char *sensor_event_topic_name(event_topic_t topic);
 void sensor_event_to_string(const app_event_t *event, char *buffer, size_t buffer_len);
 
 #ifdef __cplusplus
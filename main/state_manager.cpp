@@ -7,18 +7,24 @@ extern "C" {
 #include "driver/gpio.h"
 #include "tm1637.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #ifdef __cplusplus
 }
 #endif
 
 #include <stdio.h>
+#include <math.h>
 
 #include "state_manager.h"
 #include "sensor_events.h"
 #include "lcd.h"
 #include "mqtt_init.h"
 #include "pins.h"
+#include "app-config.h"
+#include "tick_scheduler.h"
+#include "tank_estimator.h"
+#include "tank_forecast.h"
 
 static const char *TAG = "STATE_MANAGER";
 
@@ -29,6 +35,23 @@ static tm1637_config_t s_tm1637_config = {
 };
 
 static tm1637_handle_t s_tm1637_display = nullptr;
+static sensor_events_subscriber_t *s_events = nullptr;
+static uint32_t s_tick_count = 0;
+static float s_level_volume_l = NAN;
+
+static constexpr uint32_t DEFAULT_TICK_INTERVAL_S = 30;
+
+// Uloha planovace - kazdych interval_s posle EVT_TICK
+static void emit_tick_job(void *arg)
+{
+    app_event_t event = {};
+    event.event_type = EVT_TICK;
+    event.timestamp_us = esp_timer_get_time();
+
+    if (!sensor_events_publish(&event)) {
+        ESP_LOGW(TAG, "Fronta odberatele sensor eventu je plna, tick zahozen");
+    }
+}
 
 static void publish_temperature_to_outputs(const sensor_event_t &event)
 {
@@ -48,6 +71,23 @@ static void publish_level_to_outputs(const sensor_event_t &event)
     char text[16];
     snprintf(text, sizeof(text), "H:%3.0fcm ", event.data.level.height_m * 100.0f);
     lcd_print(8, 1, text, false, 0);
+
+    if (!mqtt_is_connected()) {
+        return;
+    }
+
+    // Objem z odhadu spojeneho s prutokomerem je klidnejsi nez samotna hladina
+    tank_estimate_t estimate;
+    char payload[32];
+    if (tank_estimator_get(&estimate)) {
+        snprintf(payload, sizeof(payload), "%.1f", estimate.volume_l);
+        mqtt_publish("home/water_tank/state/volume_l", payload, true);
+        snprintf(payload, sizeof(payload), "%.2f", estimate.inflow_l_min);
+        mqtt_publish("home/water_tank/state/inflow_l_min", payload, true);
+    } else if (!isnan(event.data.level.volume_l)) {
+        snprintf(payload, sizeof(payload), "%.1f", event.data.level.volume_l);
+        mqtt_publish("home/water_tank/state/volume_l", payload, true);
+    }
 }
 
 static void publish_flow_to_outputs(const sensor_event_t &event)
@@ -65,19 +105,53 @@ static void publish_flow_to_outputs(const sensor_event_t &event)
     }
 }
 
+// JSON cislo, null pro nekonecno (nadrz se nevyprazdnuje) a NAN (nezname)
+static const char *format_forecast_value(char *buffer, size_t buffer_len, float value, const char *format)
+{
+    if (!isfinite(value)) {
+        return "null";
+    }
+    snprintf(buffer, buffer_len, format, value);
+    return buffer;
+}
+
+// Publikuje se s tickem - predpoved se meni pomalu a nema smysl ji posilat s kazdym vzorkem
+static void publish_forecast_to_outputs(void)
+{
+    if (!mqtt_is_connected()) {
+        return;
+    }
+
+    tank_estimate_t estimate;
+    const bool estimate_valid = tank_estimator_get(&estimate);
+    tank_forecast_t forecast;
+    tank_forecast_get(estimate_valid ? &estimate : nullptr, s_level_volume_l, &forecast);
+
+    char value[3][16];
+    char payload[128];
+    snprintf(payload, sizeof(payload), "{\"min\":%s,\"low\":%s,\"high\":%s,\"draw_l_min\":%.2f}",
+             format_forecast_value(value[0], sizeof(value[0]), forecast.time_to_empty_min, "%.0f"),
+             format_forecast_value(value[1], sizeof(value[1]), forecast.time_to_empty_low_min, "%.0f"),
+             format_forecast_value(value[2], sizeof(value[2]), forecast.time_to_empty_high_min, "%.0f"),
+             forecast.draw_l_min);
+    mqtt_publish("home/water_tank/state/time_to_empty", payload, true);
+
+    snprintf(payload, sizeof(payload), "{\"l_min\":%s,\"low\":%s,\"high\":%s}",
+             format_forecast_value(value[0], sizeof(value[0]), forecast.refill_l_min, "%.3f"),
+             format_forecast_value(value[1], sizeof(value[1]), forecast.refill_low_l_min, "%.3f"),
+             format_forecast_value(value[2], sizeof(value[2]), forecast.refill_high_l_min, "%.3f"));
+    mqtt_publish("home/water_tank/state/refill", payload, true);
+}
+
 static void state_manager_task(void *pvParameters)
 {
     app_event_t event = {};
-    char debug_line[128];
 
     while (true) {
-        if (!sensor_events_receive(&event, portMAX_DELAY)) {
+        if (!sensor_events_receive(s_events, &event, portMAX_DELAY)) {
             continue;
         }
 
-        sensor_event_to_string(&event, debug_line, sizeof(debug_line));
-        ESP_LOGD(TAG, "%s", debug_line);
-
         switch (event.event_type) {
             case EVT_SENSOR:
                 switch (event.data.sensor.sensor_type) {
@@ -85,9 +159,15 @@ static void state_manager_task(void *pvParameters)
                         publish_temperature_to_outputs(event.data.sensor);
                         break;
                     case SENSOR_EVENT_LEVEL:
+                        s_level_volume_l = event.data.sensor.data.level.volume_l;
+                        tank_estimator_level(event.timestamp_us, event.data.sensor.data.level.height_m);
                         publish_level_to_outputs(event.data.sensor);
                         break;
                     case SENSOR_EVENT_FLOW:
+                        tank_estimator_flow(event.timestamp_us, event.data.sensor.data.flow.total_volume_l);
+                        tank_forecast_flow(event.timestamp_us,
+                                           event.data.sensor.data.flow.flow_l_min,
+                                           event.data.sensor.data.flow.total_volume_l);
                         publish_flow_to_outputs(event.data.sensor);
                         break;
                     default:
@@ -103,7 +183,9 @@ static void state_manager_task(void *pvParameters)
                          (unsigned long)event.data.network.ip_addr);
                 break;
             case EVT_TICK:
-                ESP_LOGD(TAG, "Tick event zatim neni implementovany");
+                ++s_tick_count;
+                ESP_LOGD(TAG, "Tick #%lu", (unsigned long)s_tick_count);
+                publish_forecast_to_outputs();
                 break;
             default:
                 ESP_LOGW(TAG, "Neznamy event_type: %d", (int)event.event_type);
@@ -114,6 +196,31 @@ static void state_manager_task(void *pvParameters)
 
 void state_manager_start(void)
 {
+    const sensor_events_subscriber_config_t events_config = {
+        .name = TAG,
+        .topic_mask = EVENT_TOPIC_BIT(EVENT_TOPIC_NETWORK) | EVENT_TOPIC_BIT(EVENT_TOPIC_TICK),
+        // Displej i MQTT potrebuji jen aktualni stav senzoru, mezilehle vzorky se slucuji
+        .latest_mask = EVENT_TOPIC_BIT(EVENT_TOPIC_TEMPERATURE)
+                     | EVENT_TOPIC_BIT(EVENT_TOPIC_LEVEL)
+                     | EVENT_TOPIC_BIT(EVENT_TOPIC_FLOW),
+        .queue_length = 0,
+        .control_queue_length = 8,
+    };
+    s_events = sensor_events_subscribe(&events_config);
+    if (s_events == nullptr) {
+        ESP_LOGE(TAG, "Nelze se prihlasit k odberu sensor eventu");
+        abort();
+    }
+
+    uint32_t interval_s = DEFAULT_TICK_INTERVAL_S;
+    if (app_config_load_interval_s(&interval_s) != ESP_OK) {
+        ESP_LOGW(TAG, "interval_s neni nastaven, pouzivam %lu s", (unsigned long)interval_s);
+    }
+    if (tick_scheduler_add_job("tick", interval_s * 1000UL, emit_tick_job, NULL) == nullptr) {
+        ESP_LOGE(TAG, "Nelze naplanovat EVT_TICK");
+    }
+
+    tank_estimator_init();
     tm1637_init(&s_tm1637_config, &s_tm1637_display);
     xTaskCreate(state_manager_task, TAG, configMINIMAL_STACK_SIZE * 5, NULL, 4, NULL);
 }
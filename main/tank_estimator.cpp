@@ -0,0 +1,275 @@
+#include "tank_estimator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <freertos/FreeRTOS.h>
+#include "esp_log.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <math.h>
+#include <stdio.h>
+
+#include "diag_publisher.h"
+#include "tank_geometry.h"
+
+#define TAG "TANK_ESTIMATOR"
+
+// Sum vysky hladiny za filtrem [m]
+static constexpr float LEVEL_SIGMA_M = 0.003f;
+// U dna a vrchu lezateho valce je dV/dh skoro nulove, mereni by pak bylo
+// nerealne presne
+static constexpr float LEVEL_MIN_SIGMA_L = 0.5f;
+
+// Sum procesu na odmocninu sekundy: nemodelovane zmeny objemu (odpar,
+// netesnost), zmeny pritoku (0.05 l/min) a drift meritka (0.001 za hodinu)
+static constexpr float VOLUME_NOISE_L = 0.1f;
+static constexpr float INFLOW_NOISE_L_S = 0.05f / 60.0f;
+static constexpr float SCALE_NOISE = 0.001f / 60.0f;
+
+static constexpr float INITIAL_INFLOW_SIGMA_L_S = 2.0f / 60.0f;
+static constexpr float INITIAL_SCALE_SIGMA = 0.05f;
+static constexpr float SCALE_MIN = 0.5f;
+static constexpr float SCALE_MAX = 2.0f;
+
+// Mereni dal nez 4 sigma se zahodi; kdyz jich prijde vic za sebou, nadrz se
+// zmenila bez prutokomeru (napousteni hadici) a objem se nastavi podle hladiny
+static constexpr float GATE_SIGMA2 = 16.0f;
+static constexpr uint32_t MAX_REJECTED_IN_ROW = 5;
+
+enum {
+    X_VOLUME = 0,   // [l]
+    X_INFLOW,       // [l/s]
+    X_SCALE,
+    X_COUNT
+};
+
+static float s_x[X_COUNT];
+static float s_p[X_COUNT][X_COUNT];
+static bool s_initialized = false;
+static int64_t s_time_us = 0;
+
+static bool s_have_total = false;
+static float s_last_total_l = 0.0f;
+
+static uint32_t s_rejected_in_row = 0;
+static uint32_t s_rejected = 0;
+static uint32_t s_resets = 0;
+
+static tank_estimate_t s_snapshot = {};
+static portMUX_TYPE s_snapshot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void store_snapshot(void)
+{
+    tank_estimate_t estimate = {
+        .valid = true,
+        .volume_l = s_x[X_VOLUME],
+        .volume_sigma_l = sqrtf(s_p[X_VOLUME][X_VOLUME]),
+        .inflow_l_min = s_x[X_INFLOW] * 60.0f,
+        .inflow_sigma_l_min = sqrtf(s_p[X_INFLOW][X_INFLOW]) * 60.0f,
+        .flow_scale = s_x[X_SCALE],
+        .flow_scale_sigma = sqrtf(s_p[X_SCALE][X_SCALE]),
+        .rejected = s_rejected,
+        .resets = s_resets,
+    };
+
+    taskENTER_CRITICAL(&s_snapshot_lock);
+    s_snapshot = estimate;
+    taskEXIT_CRITICAL(&s_snapshot_lock);
+}
+
+/**
+ * Posune odhad do casu now_us: V' = V + pritok * dt - meritko * metered_l
+ * @param metered_l odber podle prutokomeru od posledniho kroku
+ */
+static void predict(int64_t now_us, float metered_l)
+{
+    // Eventy ruznych kanalu muzou prijit mirne mimo poradi, cas necouva
+    float dt = 0.0f;
+    if (now_us > s_time_us) {
+        dt = (float)(now_us - s_time_us) * 1e-6f;
+        s_time_us = now_us;
+    }
+
+    s_x[X_VOLUME] += s_x[X_INFLOW] * dt - s_x[X_SCALE] * metered_l;
+
+    // P' = F P F^T + Q
+    const float f[X_COUNT][X_COUNT] = {
+        {1.0f, dt, -metered_l},
+        {0.0f, 1.0f, 0.0f},
+        {0.0f, 0.0f, 1.0f},
+    };
+    float fp[X_COUNT][X_COUNT];
+    for (int row = 0; row < X_COUNT; ++row) {
+        for (int col = 0; col < X_COUNT; ++col) {
+            float sum = 0.0f;
+            for (int k = 0; k < X_COUNT; ++k) {
+                sum += f[row][k] * s_p[k][col];
+            }
+            fp[row][col] = sum;
+        }
+    }
+    for (int row = 0; row < X_COUNT; ++row) {
+        for (int col = row; col < X_COUNT; ++col) {
+            float sum = 0.0f;
+            for (int k = 0; k < X_COUNT; ++k) {
+                sum += fp[row][k] * f[col][k];
+            }
+            s_p[row][col] = sum;
+            s_p[col][row] = sum;
+        }
+    }
+
+    // Objem je integral pritoku, proto ma sum pritoku i krizovy clen
+    const float q_inflow = INFLOW_NOISE_L_S * INFLOW_NOISE_L_S;
+    s_p[X_VOLUME][X_VOLUME] += VOLUME_NOISE_L * VOLUME_NOISE_L * dt + q_inflow * dt * dt * dt / 3.0f;
+    s_p[X_VOLUME][X_INFLOW] += q_inflow * dt * dt / 2.0f;
+    s_p[X_INFLOW][X_VOLUME] = s_p[X_VOLUME][X_INFLOW];
+    s_p[X_INFLOW][X_INFLOW] += q_inflow * dt;
+    s_p[X_SCALE][X_SCALE] += SCALE_NOISE * SCALE_NOISE * dt;
+}
+
+// Objem primo podle hladiny, bez vazby na pritok a meritko
+static void reset_volume(float volume_l, float variance_l2)
+{
+    s_x[X_VOLUME] = volume_l;
+    for (int index = 0; index < X_COUNT; ++index) {
+        s_p[X_VOLUME][index] = 0.0f;
+        s_p[index][X_VOLUME] = 0.0f;
+    }
+    s_p[X_VOLUME][X_VOLUME] = variance_l2;
+    s_rejected_in_row = 0;
+}
+
+static void tank_estimator_diag(void)
+{
+    tank_estimate_t estimate;
+    if (!tank_estimator_get(&estimate)) {
+        return;
+    }
+
+    char payload[224];
+    snprintf(payload,
+             sizeof(payload),
+             "{\"volume_l\":%.1f,\"sigma_l\":%.2f,\"inflow_l_min\":%.3f,\"inflow_sigma_l_min\":%.3f,"
+             "\"flow_scale\":%.4f,\"flow_scale_sigma\":%.4f,\"rejected\":%lu,\"resets\":%lu}",
+             estimate.volume_l,
+             estimate.volume_sigma_l,
+             estimate.inflow_l_min,
+             estimate.inflow_sigma_l_min,
+             estimate.flow_scale,
+             estimate.flow_scale_sigma,
+             (unsigned long)estimate.rejected,
+             (unsigned long)estimate.resets);
+    diag_publish("tank/estimator", payload);
+}
+
+void tank_estimator_init(void)
+{
+    if (diag_publisher_register(tank_estimator_diag) != ESP_OK) {
+        ESP_LOGW(TAG, "Diagnostika odhadu nadrze nebude publikovana");
+    }
+}
+
+void tank_estimator_flow(int64_t timestamp_us, float total_volume_l)
+{
+    // Prvni hodnota nebo reset citace - jen nova vychozi hodnota
+    if (!s_have_total || total_volume_l < s_last_total_l) {
+        s_have_total = true;
+        s_last_total_l = total_volume_l;
+        return;
+    }
+
+    const float metered_l = total_volume_l - s_last_total_l;
+    s_last_total_l = total_volume_l;
+    if (!s_initialized) {
+        return;
+    }
+
+    predict(timestamp_us, metered_l);
+    store_snapshot();
+}
+
+bool tank_estimator_level(int64_t timestamp_us, float height_m)
+{
+    const float volume_l = tank_geometry_volume_l(height_m);
+    if (isnan(volume_l)) {
+        return false;
+    }
+
+    // Sum vysky prepocteny pres tvar nadrze v miste hladiny
+    const float spread_l = 0.5f * (tank_geometry_volume_l(height_m + LEVEL_SIGMA_M)
+                                   - tank_geometry_volume_l(height_m - LEVEL_SIGMA_M));
+    const float sigma_l = fmaxf(LEVEL_MIN_SIGMA_L, spread_l);
+    const float variance_l2 = sigma_l * sigma_l;
+
+    if (!s_initialized) {
+        s_x[X_INFLOW] = 0.0f;
+        s_x[X_SCALE] = 1.0f;
+        for (int row = 0; row < X_COUNT; ++row) {
+            for (int col = 0; col < X_COUNT; ++col) {
+                s_p[row][col] = 0.0f;
+            }
+        }
+        s_p[X_INFLOW][X_INFLOW] = INITIAL_INFLOW_SIGMA_L_S * INITIAL_INFLOW_SIGMA_L_S;
+        s_p[X_SCALE][X_SCALE] = INITIAL_SCALE_SIGMA * INITIAL_SCALE_SIGMA;
+        reset_volume(volume_l, variance_l2);
+        s_time_us = timestamp_us;
+        s_initialized = true;
+        store_snapshot();
+        ESP_LOGI(TAG, "Odhad nadrze zahajen, objem %.1f l", volume_l);
+        return true;
+    }
+
+    predict(timestamp_us, 0.0f);
+
+    const float innovation = volume_l - s_x[X_VOLUME];
+    const float innovation_var = s_p[X_VOLUME][X_VOLUME] + variance_l2;
+    if (innovation * innovation > GATE_SIGMA2 * innovation_var) {
+        ++s_rejected;
+        if (++s_rejected_in_row < MAX_REJECTED_IN_ROW) {
+            store_snapshot();
+            return false;
+        }
+
+        ESP_LOGW(TAG, "Hladina nesedi s odhadem o %.1f l, objem nastaven podle hladiny", innovation);
+        ++s_resets;
+        reset_volume(volume_l, variance_l2);
+        // Zmena bez prutokomeru - pritok se musi naucit znovu
+        s_p[X_INFLOW][X_INFLOW] = fmaxf(s_p[X_INFLOW][X_INFLOW],
+                                        INITIAL_INFLOW_SIGMA_L_S * INITIAL_INFLOW_SIGMA_L_S);
+        store_snapshot();
+        return true;
+    }
+    s_rejected_in_row = 0;
+
+    // Merime jen objem (H = [1 0 0]), zisk je prvni sloupec P / rozptyl inovace
+    float gain[X_COUNT];
+    float volume_row[X_COUNT];
+    for (int index = 0; index < X_COUNT; ++index) {
+        gain[index] = s_p[index][X_VOLUME] / innovation_var;
+        volume_row[index] = s_p[X_VOLUME][index];
+    }
+    for (int row = 0; row < X_COUNT; ++row) {
+        s_x[row] += gain[row] * innovation;
+        for (int col = 0; col < X_COUNT; ++col) {
+            s_p[row][col] -= gain[row] * volume_row[col];
+        }
+    }
+
+    s_x[X_SCALE] = fminf(SCALE_MAX, fmaxf(SCALE_MIN, s_x[X_SCALE]));
+    store_snapshot();
+    return true;
+}
+
+bool tank_estimator_get(tank_estimate_t *estimate)
+{
+    taskENTER_CRITICAL(&s_snapshot_lock);
+    *estimate = s_snapshot;
+    taskEXIT_CRITICAL(&s_snapshot_lock);
+    return estimate->valid;
+}
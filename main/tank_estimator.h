@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Odhad stavu nadrze z hladiny a prutokomeru (Kalmanuv filtr se 3 stavy).
+ *
+ * Stav: skutecny objem [l], cisty pritok mimo prutokomer [l/s] (dest,
+ * doplnovani; kladny = plneni) a meritko prutokomeru (skutecne / namerene
+ * litry). Mezi mericimi hladiny se objem posouva o pritok a o odber
+ * namereny prutokomerem, mereni hladiny (prepoctene na objem podle tvaru
+ * nadrze) ho pak opravi. Pri cerpani se tak z poklesu hladiny dopocita
+ * meritko prutokomeru, v klidu pritok.
+ *
+ * Volat jen z jedne ulohy (state manager); tank_estimator_get() a diagnostika
+ * ctou kopii chranenou zamkem.
+ */
+
+typedef struct {
+    bool valid;               // false dokud neprislo prvni mereni hladiny
+    float volume_l;
+    float volume_sigma_l;     // smerodatna odchylka odhadu objemu
+    float inflow_l_min;       // cisty pritok mimo prutokomer
+    float inflow_sigma_l_min; // smerodatna odchylka odhadu pritoku
+    float flow_scale;         // 1 = prutokomer meri presne
+    float flow_scale_sigma;
+    uint32_t rejected;        // mereni hladiny zahozena jako odlehla
+    uint32_t resets;          // znovunastaveni objemu po opakovane odlehlych merenich
+} tank_estimate_t;
+
+// Zaregistruje diagnostiku (diag/tank/estimator), volat z inicializace
+void tank_estimator_init(void);
+
+/**
+ * Zapocte odber podle prutokomeru.
+ * @param total_volume_l celkovy namereny objem (stoupajici citac)
+ */
+void tank_estimator_flow(int64_t timestamp_us, float total_volume_l);
+
+/**
+ * Opravi odhad merenim hladiny. Objem se pocita z tvaru nadrze
+ * (tank_geometry), bez sestavene tabulky se mereni ignoruje.
+ * @return true pokud se odhad zmenil
+ */
+bool tank_estimator_level(int64_t timestamp_us, float height_m);
+
+/**
+ * Posledni odhad.
+ * @return estimate->valid
+ */
+bool tank_estimator_get(tank_estimate_t *estimate);
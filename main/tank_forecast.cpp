@@ -0,0 +1,92 @@
+#include "tank_forecast.h"
+
+#include <math.h>
+
+#include "ew_regression.hpp"
+
+// Odber sleduje zmeny otacek cerpadla
+static constexpr float DRAW_TIME_CONSTANT_S = 120.0f;
+
+// Pod timto prutokem cerpadlo stoji
+static constexpr float DRAW_MIN_L_MIN = 0.1f;
+// 95% meze
+static constexpr float CONFIDENCE_Z = 1.96f;
+
+static EwRegression s_draw(DRAW_TIME_CONSTANT_S);      // namereny objem [l] v case [s]
+
+static int64_t s_last_flow_us = 0;
+static float s_last_total_l = 0.0f;
+static bool s_pumping = false;
+
+// Cas od predchoziho eventu; u prvniho vzorku regrese na nem nezalezi
+static float seconds_since(int64_t *last_us, int64_t now_us)
+{
+    if (now_us <= *last_us) {
+        return 0.0f;
+    }
+    const float elapsed = (float)(now_us - *last_us) * 1e-6f;
+    *last_us = now_us;
+    return elapsed;
+}
+
+void tank_forecast_flow(int64_t timestamp_us, float flow_l_min, float total_volume_l)
+{
+    // Reset citace - stara smernice by nesedela
+    if (total_volume_l < s_last_total_l) {
+        s_draw.reset();
+    }
+    s_last_total_l = total_volume_l;
+    const float elapsed = seconds_since(&s_last_flow_us, timestamp_us);
+
+    // Odber se meri jen za behu cerpadla, kazde spusteni od zacatku
+    const bool pumping = flow_l_min >= DRAW_MIN_L_MIN;
+    if (pumping && !s_pumping) {
+        s_draw.reset();
+    }
+    s_pumping = pumping;
+    if (pumping) {
+        s_draw.insert(elapsed, total_volume_l);
+    }
+}
+
+void tank_forecast_get(const tank_estimate_t *estimate, float level_volume_l, tank_forecast_t *forecast)
+{
+    // Bez odberu se nadrz nevyprazdni, bez mereni dotok neni znamy
+    *forecast = {
+        .draining = false,
+        .time_to_empty_min = INFINITY,
+        .time_to_empty_low_min = INFINITY,
+        .time_to_empty_high_min = INFINITY,
+        .draw_l_min = 0.0f,
+        .refill_valid = false,
+        .refill_l_min = NAN,
+        .refill_low_l_min = NAN,
+        .refill_high_l_min = NAN,
+    };
+
+    const float volume_l = estimate != nullptr ? estimate->volume_l : level_volume_l;
+    const float flow_scale = estimate != nullptr ? estimate->flow_scale : 1.0f;
+    const float draw_l_min = s_pumping ? s_draw.getSlope() * 60.0f * flow_scale : 0.0f;
+    const float draw_error_l_min = CONFIDENCE_Z * s_draw.getSlopeStdError() * 60.0f * flow_scale;
+    forecast->draw_l_min = draw_l_min;
+    if (s_pumping && draw_l_min >= DRAW_MIN_L_MIN && !isnan(volume_l)) {
+        const float usable_l = fmaxf(0.0f, volume_l);
+        forecast->draining = true;
+        forecast->time_to_empty_min = usable_l / draw_l_min;
+        // Chyba smernice je znama az od tri efektivnich vzorku po spusteni
+        forecast->time_to_empty_low_min = isfinite(draw_error_l_min)
+            ? usable_l / (draw_l_min + draw_error_l_min)
+            : NAN;
+        forecast->time_to_empty_high_min = draw_l_min > draw_error_l_min
+            ? usable_l / (draw_l_min - draw_error_l_min)
+            : INFINITY;
+    }
+
+    if (estimate != nullptr) {
+        const float refill_error_l_min = CONFIDENCE_Z * estimate->inflow_sigma_l_min;
+        forecast->refill_valid = true;
+        forecast->refill_l_min = estimate->inflow_l_min;
+        forecast->refill_low_l_min = estimate->inflow_l_min - refill_error_l_min;
+        forecast->refill_high_l_min = estimate->inflow_l_min + refill_error_l_min;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tank_estimator.h"
+
+/**
+ * Predpoved vydrze nadrze: za jak dlouho se pri soucasnem odberu vyprazdni
+ * a jak rychle se plni (dest), obe s 95% mezemi.
+ *
+ * Odber je smernice namereneho objemu prutokomeru v kratkem okne - regrese
+ * s exponencialnim zapominanim (ew_regression.hpp), konstantni pamet a O(1)
+ * na event. Dotok je cisty pritok z odhadu nadrze (tank_estimator) a jeho
+ * nejistota, aby se neposilala dve ruzna cisla pro tutez velicinu.
+ *
+ * Volat jen z jedne ulohy (state manager).
+ */
+
+typedef struct {
+    bool draining;                // odber nad prahem, jinak casy INFINITY
+    float time_to_empty_min;
+    float time_to_empty_low_min;  // NAN dokud chyba odberu neni znama
+    float time_to_empty_high_min; // INFINITY pokud odber muze byt nulovy
+    float draw_l_min;             // soucasny odber vcetne meritka prutokomeru
+
+    bool refill_valid;            // odhad nadrze ma prvni mereni, jinak NAN
+    float refill_l_min;           // zaporne = ztraty (odpar, netesnost)
+    float refill_low_l_min;
+    float refill_high_l_min;
+} tank_forecast_t;
+
+/**
+ * Zapocte event prutokomeru.
+ * @param flow_l_min okamzity prutok - nad prahem se bere jako cerpani
+ * @param total_volume_l celkovy namereny objem
+ */
+void tank_forecast_flow(int64_t timestamp_us, float flow_l_min, float total_volume_l);
+
+/**
+ * Spocita predpoved.
+ * @param estimate odhad nadrze (objem, meritko prutokomeru, pritok), NULL
+ *                 pokud jeste neni
+ * @param level_volume_l objem podle hladiny pro cas do vyprazdneni bez odhadu
+ *                       (NAN = cas do vyprazdneni neplati)
+ */
+void tank_forecast_get(const tank_estimate_t *estimate, float level_volume_l, tank_forecast_t *forecast);
@@ -0,0 +1,143 @@
+#include "tank_geometry.h"
+
+#include <math.h>
+#include "esp_log.h"
+#include "piecewise_linear.hpp"
+
+#define TAG "TANK_GEOMETRY"
+
+static constexpr size_t TANK_TABLE_MAX_POINTS = 32;
+
+static float s_volume_lut[TANK_GEOMETRY_LUT_SEGMENTS + 1];
+static float s_segments_per_m = 0.0f;
+static bool s_built = false;
+
+// Plocha kruhove usece do vysky h krat delka
+static float cylinder_volume_l(float diameter_m, float length_m, float height_m)
+{
+    const float radius = diameter_m / 2.0f;
+    const float offset = radius - height_m;
+    const float chord_term = offset * sqrtf(fmaxf(0.0f, 2.0f * radius * height_m - height_m * height_m));
+    const float area = radius * radius * acosf(fmaxf(-1.0f, fminf(1.0f, offset / radius))) - chord_term;
+    return area * length_m * 1000.0f;
+}
+
+// Body "vyska_m:litry"; vysky musi ostre rust a objemy nesmi klesat
+static esp_err_t parse_table(const char *text, float *heights, float *volumes, size_t *count)
+{
+    const size_t points = parsePiecewisePoints(text, heights, volumes, TANK_TABLE_MAX_POINTS);
+    if (points < 2 || heights[0] < 0.0f || volumes[0] < 0.0f) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t index = 1; index < points; ++index) {
+        if (volumes[index] < volumes[index - 1]) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    *count = points;
+    return ESP_OK;
+}
+
+// Pod prvnim bodem plati jeho objem, mezi body linearne
+static float table_volume_l(const float *heights, const float *volumes, size_t count, float height_m)
+{
+    if (height_m <= heights[0]) {
+        return volumes[0];
+    }
+    for (size_t index = 1; index < count; ++index) {
+        if (height_m <= heights[index]) {
+            const float ratio = (height_m - heights[index - 1]) / (heights[index] - heights[index - 1]);
+            return volumes[index - 1] + ratio * (volumes[index] - volumes[index - 1]);
+        }
+    }
+    return volumes[count - 1];
+}
+
+esp_err_t tank_geometry_build(const tank_geometry_config_t *config)
+{
+    if (config == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_built = false;
+
+    float heights[TANK_TABLE_MAX_POINTS];
+    float volumes[TANK_TABLE_MAX_POINTS];
+    size_t point_count = 0;
+    float max_height_m = 0.0f;
+
+    switch (config->shape) {
+        case TANK_SHAPE_PRISM:
+            if (!(config->height_m > 0.0f) || !(config->area_m2 > 0.0f)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            max_height_m = config->height_m;
+            break;
+        case TANK_SHAPE_HORIZONTAL_CYLINDER:
+            if (!(config->diameter_m > 0.0f) || !(config->length_m > 0.0f)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            max_height_m = config->diameter_m;
+            break;
+        case TANK_SHAPE_TABLE: {
+            if (config->table == nullptr) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            const esp_err_t result = parse_table(config->table, heights, volumes, &point_count);
+            if (result != ESP_OK) {
+                return result;
+            }
+            max_height_m = heights[point_count - 1];
+            break;
+        }
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+
+    const float step_m = max_height_m / TANK_GEOMETRY_LUT_SEGMENTS;
+    for (size_t index = 0; index <= TANK_GEOMETRY_LUT_SEGMENTS; ++index) {
+        const float height_m = step_m * (float)index;
+        switch (config->shape) {
+            case TANK_SHAPE_PRISM:
+                s_volume_lut[index] = config->area_m2 * height_m * 1000.0f;
+                break;
+            case TANK_SHAPE_HORIZONTAL_CYLINDER:
+                s_volume_lut[index] = cylinder_volume_l(config->diameter_m, config->length_m, height_m);
+                break;
+            case TANK_SHAPE_TABLE:
+                s_volume_lut[index] = table_volume_l(heights, volumes, point_count, height_m);
+                break;
+        }
+    }
+
+    s_segments_per_m = TANK_GEOMETRY_LUT_SEGMENTS / max_height_m;
+    s_built = true;
+
+    ESP_LOGI(TAG, "Nadrz tvar=%d, vyska %.3f m, objem %.1f l",
+             (int)config->shape, max_height_m, s_volume_lut[TANK_GEOMETRY_LUT_SEGMENTS]);
+    return ESP_OK;
+}
+
+float tank_geometry_volume_l(float height_m)
+{
+    if (!s_built) {
+        return NAN;
+    }
+    if (!(height_m > 0.0f)) {
+        return s_volume_lut[0];
+    }
+
+    const float position = height_m * s_segments_per_m;
+    if (position >= (float)TANK_GEOMETRY_LUT_SEGMENTS) {
+        return s_volume_lut[TANK_GEOMETRY_LUT_SEGMENTS];
+    }
+
+    const size_t index = (size_t)position;
+    const float fraction = position - (float)index;
+    return s_volume_lut[index] + fraction * (s_volume_lut[index + 1] - s_volume_lut[index]);
+}
+
+float tank_geometry_capacity_l(void)
+{
+    return s_built ? s_volume_lut[TANK_GEOMETRY_LUT_SEGMENTS] : 0.0f;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * Prevod vysky hladiny na objem nadrze.
+ *
+ * Tvar nadrze se pri nacteni konfigurace jednou prepocita do huste tabulky
+ * vyska -> litry, kazdy vzorek pak stoji jen indexovani a linearni
+ * interpolaci (zadna trigonometrie za behu).
+ */
+
+typedef enum {
+    TANK_SHAPE_PRISM = 0,               // svisle steny, stala plocha dna
+    TANK_SHAPE_HORIZONTAL_CYLINDER = 1, // lezaty valec
+    TANK_SHAPE_TABLE = 2,               // body vyska:litry z konfigurace
+} tank_shape_t;
+
+typedef struct {
+    tank_shape_t shape;
+    float height_m;      // hranol: vyska nadrze
+    float area_m2;       // hranol: plocha dna
+    float diameter_m;    // valec: prumer (= vyska)
+    float length_m;      // valec: delka
+    const char *table;   // tabulka: "vyska_m:litry,..." s rostouci vyskou, aspon 2 body
+} tank_geometry_config_t;
+
+// Pocet useku tabulky mezi nulou a maximalni vyskou
+#define TANK_GEOMETRY_LUT_SEGMENTS 256
+
+/**
+ * Sestavi tabulku pro dany tvar. Volat pred prvnim tank_geometry_volume_l(),
+ * neni chraneno proti soubeznemu cteni.
+ * @return ESP_ERR_INVALID_ARG pri nesmyslnych rozmerech nebo chybne tabulce
+ */
+esp_err_t tank_geometry_build(const tank_geometry_config_t *config);
+
+/**
+ * Objem v litrech pro vysku hladiny. Pod dnem 0, nad maximem plny objem.
+ * @return NAN pokud tabulka neni sestavena
+ */
+float tank_geometry_volume_l(float height_m);
+
+// Objem plne nadrze v litrech (0 pokud tabulka neni sestavena)
+float tank_geometry_capacity_l(void);
@@ -16,7 +16,9 @@ extern "C" {
 #endif
 
 #include "pins.h"
+#include "teplota-demo.h"
 #include "sensor_events.h"
+#include "tick_scheduler.h"
 
 #define TAG "TEMP_DEMO"
 
@@ -37,16 +39,37 @@ typedef struct {
     uint8_t reserved[7];   // ostatní bajty
 } ds18b20_scratchpad_t;
 
+static const int32_t TEMPERATURE_DEFAULT_PERIOD_MS = 1000;
+
+static const config_item_t TEMPERATURE_CONFIG_ITEMS[] = {
+    {
+        .key = "temp_period_ms",
+        .label = "Perioda měření teploty [ms]",
+        .description = "Převod DS18B20 trvá až 750 ms, kratší perioda není možná.",
+        .type = CONFIG_VALUE_INT32,
+        .default_string = nullptr,
+        .default_int = TEMPERATURE_DEFAULT_PERIOD_MS,
+        .default_float = 0.0f,
+        .default_bool = false,
+        .max_string_len = 0,
+        .min_int = 800,
+        .max_int = 60000,
+        .min_float = 0.0f,
+        .max_float = 0.0f,
+    },
+};
+
+// Převod z minulé periody čeká na vyčtení
+static bool s_conversion_pending = false;
+
 /**
- * Přečte teplotu z DS18B20 sensoru
+ * Spustí převod teploty na DS18B20 sensoru. Výsledek je k dispozici nejdříve
+ * za 750 ms (12-bit rozlišení), vyčítá ho až další spuštění úlohy.
  * @param gpio GPIO pin s 1-Wire senzorem
- * @param temp ukazatel na float kde se uloží výsledek
  * @return true pokud se podařilo, false pokud chyba
  */
-static bool ds18b20_read_temperature(gpio_num_t gpio, float *temp)
+static bool ds18b20_start_conversion(gpio_num_t gpio)
 {
-    if (!temp) return false;
-    
     // Reset bus
     if (!onewire_reset(gpio)) {
         ESP_LOGE(TAG, "Chyba: senzor neodpověděl na reset");
@@ -64,9 +87,19 @@ static bool ds18b20_read_temperature(gpio_num_t gpio, float *temp)
         ESP_LOGE(TAG, "Chyba: Nebylo možno poslat Convert T příkaz");
         return false;
     }
-    
-    // Čekáme na konverzi (max 750ms pro 12-bit rozlišení)
-    vTaskDelay(pdMS_TO_TICKS(800));
+
+    return true;
+}
+
+/**
+ * Přečte výsledek dříve spuštěného převodu z DS18B20 sensoru
+ * @param gpio GPIO pin s 1-Wire senzorem
+ * @param temp ukazatel na float kde se uloží výsledek
+ * @return true pokud se podařilo, false pokud chyba
+ */
+static bool ds18b20_read_result(gpio_num_t gpio, float *temp)
+{
+    if (!temp) return false;
     
     // Reset bus znovu
     if (!onewire_reset(gpio)) {
@@ -102,16 +135,14 @@ static bool ds18b20_read_temperature(gpio_num_t gpio, float *temp)
     return true;
 }
 
-static void temperature_task(void *pvParameters)
+// Úloha plánovače: vyčte převod z minulé periody a hned spustí další,
+// takže se na převod nikde nečeká
+static void temperature_job(void *arg)
 {
-    // Nastavení pull-up rezistoru na GPIO pinu
-    gpio_set_pull_mode(SENSOR_GPIO, GPIO_PULLUP_ONLY);
-    
     float temperature;
-    
-    while (1)
-    {
-        if (ds18b20_read_temperature(SENSOR_GPIO, &temperature)) {
+
+    if (s_conversion_pending) {
+        if (ds18b20_read_result(SENSOR_GPIO, &temperature)) {
             ESP_LOGI(TAG, "Teplota: %.2f °C", temperature);
 
             app_event_t event = {
@@ -129,19 +160,38 @@ static void temperature_task(void *pvParameters)
                 },
             };
 
-            if (!sensor_events_publish(&event, pdMS_TO_TICKS(50))) {
-                ESP_LOGW(TAG, "Fronta sensor eventu je plna, teplota zahozena");
+            if (!sensor_events_publish(&event)) {
+                ESP_LOGW(TAG, "Fronta odberatele sensor eventu je plna, teplota zahozena");
             }
         } else {
             ESP_LOGE(TAG, "Nebylo možno přečíst teplotu");
         }
-        
-        // Čtení každou sekundu
-        vTaskDelay(pdMS_TO_TICKS(1000));
     }
+
+    s_conversion_pending = ds18b20_start_conversion(SENSOR_GPIO);
 }
 
 void teplota_demo_init(void)
 {
-    xTaskCreate(temperature_task, TAG, configMINIMAL_STACK_SIZE * 4, NULL, 5, NULL);
+    // Nastavení pull-up rezistoru na GPIO pinu
+    gpio_set_pull_mode(SENSOR_GPIO, GPIO_PULLUP_ONLY);
+
+    int32_t period_ms = TEMPERATURE_DEFAULT_PERIOD_MS;
+    ESP_ERROR_CHECK(config_webapp_get_i32("temp_period_ms", &period_ms));
+    if (period_ms <= 0) {
+        period_ms = TEMPERATURE_DEFAULT_PERIOD_MS;
+    }
+
+    if (tick_scheduler_add_job(TAG, (uint32_t)period_ms, temperature_job, NULL) == nullptr) {
+        ESP_LOGE(TAG, "Nelze naplanovat mereni teploty");
+    }
+}
+
+config_group_t teplota_demo_get_config_group(void)
+{
+    config_group_t group = {
+        .items = TEMPERATURE_CONFIG_ITEMS,
+        .item_count = sizeof(TEMPERATURE_CONFIG_ITEMS) / sizeof(TEMPERATURE_CONFIG_ITEMS[0]),
+    };
+    return group;
 }
@@ -1,3 +1,6 @@
 #pragma once
 
+#include "config_webapp.h"
+
 void teplota_demo_init(void);
+config_group_t teplota_demo_get_config_group(void);
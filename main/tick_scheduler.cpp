@@ -0,0 +1,191 @@
+#include "tick_scheduler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#define TAG "TICK_SCHED"
+
+static constexpr size_t WHEEL_SLOTS = 64;
+static constexpr uint32_t WORKER_STACK_SIZE = 6144;
+static constexpr UBaseType_t WORKER_PRIORITY = 5;
+
+struct tick_job {
+    const char *name;
+    tick_job_fn fn;
+    void *arg;
+    uint32_t period_ticks;
+    uint64_t due_tick;       // absolutni tik pristiho spusteni
+    tick_job_t *next;        // dalsi uloha ve stejne prihradce kola
+    bool used;
+};
+
+static tick_job_t s_jobs[TICK_SCHEDULER_MAX_JOBS];
+static tick_job_t *s_wheel[WHEEL_SLOTS];
+static portMUX_TYPE s_wheel_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint64_t s_current_tick = 0;   // posledni zpracovany tik
+static uint32_t s_resolution_ms = 0;
+static esp_timer_handle_t s_timer = nullptr;
+static TaskHandle_t s_worker = nullptr;
+
+static uint32_t period_to_ticks(uint32_t period_ms)
+{
+    const uint32_t ticks = (period_ms + s_resolution_ms / 2) / s_resolution_ms;
+    return ticks == 0 ? 1 : ticks;
+}
+
+// Volat se zamcenym s_wheel_lock
+static void wheel_insert(tick_job_t *job)
+{
+    tick_job_t **slot = &s_wheel[job->due_tick % WHEEL_SLOTS];
+    job->next = *slot;
+    *slot = job;
+}
+
+static void timer_callback(void *arg)
+{
+    xTaskNotifyGive(s_worker);
+}
+
+static void run_tick(uint64_t tick)
+{
+    // Vyjmeme z prihradky splatne ulohy; ostatni tam cekaji na dalsi otocku kola
+    tick_job_t *due = nullptr;
+    taskENTER_CRITICAL(&s_wheel_lock);
+    tick_job_t **link = &s_wheel[tick % WHEEL_SLOTS];
+    while (*link != nullptr) {
+        tick_job_t *job = *link;
+        if (job->due_tick <= tick) {
+            *link = job->next;
+            job->next = due;
+            due = job;
+        } else {
+            link = &job->next;
+        }
+    }
+    taskEXIT_CRITICAL(&s_wheel_lock);
+
+    while (due != nullptr) {
+        tick_job_t *job = due;
+        due = job->next;
+
+        job->fn(job->arg);
+
+        taskENTER_CRITICAL(&s_wheel_lock);
+        job->due_tick += job->period_ticks;
+        if (job->due_tick <= tick) {
+            // uloha se nestihla - dalsi termin az v budoucnu, ale ve stejne fazi
+            const uint64_t missed = (tick - job->due_tick) / job->period_ticks + 1;
+            job->due_tick += missed * job->period_ticks;
+        }
+        wheel_insert(job);
+        taskEXIT_CRITICAL(&s_wheel_lock);
+    }
+}
+
+static void worker_task(void *pvParameters)
+{
+    const int64_t start_us = esp_timer_get_time();
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Cilovy tik z casu - kdyz se nektere notifikace slily, dozpracujeme je
+        const uint64_t target_tick =
+            static_cast<uint64_t>((esp_timer_get_time() - start_us) / (static_cast<int64_t>(s_resolution_ms) * 1000));
+        while (true) {
+            taskENTER_CRITICAL(&s_wheel_lock);
+            const bool behind = s_current_tick < target_tick;
+            if (behind) {
+                s_current_tick += 1;
+            }
+            const uint64_t tick = s_current_tick;
+            taskEXIT_CRITICAL(&s_wheel_lock);
+
+            if (!behind) {
+                break;
+            }
+            run_tick(tick);
+        }
+    }
+}
+
+esp_err_t tick_scheduler_start(uint32_t resolution_ms)
+{
+    if (resolution_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_timer != nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_resolution_ms = resolution_ms;
+
+    if (xTaskCreate(worker_task, TAG, WORKER_STACK_SIZE, NULL, WORKER_PRIORITY, &s_worker) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = timer_callback,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "tick_sched",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t result = esp_timer_create(&timer_args, &s_timer);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    result = esp_timer_start_periodic(s_timer, static_cast<uint64_t>(resolution_ms) * 1000);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    ESP_LOGI(TAG, "Planovac bezi s rozlisenim %lu ms", (unsigned long)resolution_ms);
+    return ESP_OK;
+}
+
+tick_job_t *tick_scheduler_add_job(const char *name, uint32_t period_ms, tick_job_fn fn, void *arg)
+{
+    if (s_resolution_ms == 0 || fn == nullptr || period_ms == 0) {
+        return nullptr;
+    }
+
+    tick_job_t *job = nullptr;
+    taskENTER_CRITICAL(&s_wheel_lock);
+    for (size_t index = 0; index < TICK_SCHEDULER_MAX_JOBS; ++index) {
+        if (!s_jobs[index].used) {
+            job = &s_jobs[index];
+            job->used = true;
+            job->name = name;
+            job->fn = fn;
+            job->arg = arg;
+            job->period_ticks = period_to_ticks(period_ms);
+            job->due_tick = s_current_tick + job->period_ticks;
+            wheel_insert(job);
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_wheel_lock);
+
+    if (job == nullptr) {
+        ESP_LOGE(TAG, "Neni volne misto pro ulohu %s", name != nullptr ? name : "?");
+        return nullptr;
+    }
+
+    ESP_LOGI(TAG,
+             "Uloha %s kazdych %lu ms",
+             name != nullptr ? name : "?",
+             (unsigned long)(job->period_ticks * s_resolution_ms));
+    return job;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Centralni planovac periodickych uloh nad jednim esp_timer.
+ *
+ * Casovac tika s pevnym rozlisenim, ulohy jsou v casovem kole (timer wheel)
+ * a spousti je jediny pracovni task. Dalsi termin ulohy se pocita od
+ * predchoziho terminu, ne od skutecneho dobehu, takze perioda neujizdi.
+ * Ulohy maji byt kratke - dlouha uloha zpozdi ostatni (ne vsak posune jejich
+ * dalsi terminy).
+ */
+
+typedef void (*tick_job_fn)(void *arg);
+typedef struct tick_job tick_job_t;
+
+#define TICK_SCHEDULER_MAX_JOBS 8
+
+/**
+ * Spusti planovac.
+ * @param resolution_ms delka jednoho tika; periody uloh se na ni zaokrouhluji
+ */
+esp_err_t tick_scheduler_start(uint32_t resolution_ms);
+
+/**
+ * Prida periodickou ulohu. Poprve se spusti za jednu periodu.
+ * @return handle ulohy nebo NULL pri chybe
+ */
+tick_job_t *tick_scheduler_add_job(const char *name, uint32_t period_ms, tick_job_fn fn, void *arg);
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
 #include <cstdint>
+#include <limits>
+#include <type_traits>
 
 /**
  * Třída pro výpočet oříznutého průměru (trimmed mean)
@@ -10,26 +13,41 @@
  * Parametry template:
  * - BufferSize: velikost bufferu (počet hodnot k uchovávání)
  * - TrimCount: počet hodnot k odstranění z každé strany
+ * - T: typ hodnot (uint16_t RAW z ADC, int32_t mikrovolty, celé číslo
+ *   s pevnou řádovou čárkou, ...)
  * 
  * Příklad:
  *   TrimmedMean<31, 5> adc_filter;  // buffer 31 prvků, odstraní 5 min a 5 max
  *   adc_filter.insert(raw_value);
  *   uint32_t avg = adc_filter.getValue();
  */
-template<size_t BufferSize = 31, size_t TrimCount = 5>
+template<size_t BufferSize = 31, size_t TrimCount = 5, typename T = uint32_t>
 class TrimmedMean
 {
 private:
+    static_assert(TrimCount < BufferSize / 2, "TrimCount musí být menší než polovina BufferSize");
+    static_assert(std::is_arithmetic<T>::value, "T musí být číselný typ");
+
+    // Pořadí se vejde do 16 bitů pro většinu bufferů - záznam uint16_t
+    // hodnoty pak má 4 bajty místo 8
+    typedef typename std::conditional<(BufferSize < UINT16_MAX), uint16_t, uint32_t>::type OrderType;
+    typedef typename std::conditional<std::is_floating_point<T>::value, double,
+            typename std::conditional<std::is_signed<T>::value, int64_t, uint64_t>::type>::type SumType;
+
+    // Pořadí sentinelů, které se nikdy nerovná current_order
+    static constexpr OrderType SentinelOrder = (OrderType)BufferSize;
+
+    // Pod tento počet je levnější vkládat po jedné než přeřadit celý buffer
+    static constexpr size_t BulkSortThreshold = 8;
+
     struct BufferEntry
     {
-        int order;          // pořadí vložení
-        uint32_t value;     // hodnota
+        T value;            // hodnota
+        OrderType order;    // pořadí vložení
     };
     
-    static_assert(TrimCount < BufferSize / 2, "TrimCount musí být menší než polovina BufferSize");
-    
     BufferEntry buffer[BufferSize + 2];  // buffer + 2 sentinel hodnoty
-    int current_order;                    // aktuální pořadí
+    OrderType current_order;              // aktuální pořadí
 
 public:
     /**
@@ -38,17 +56,17 @@ public:
     TrimmedMean() : current_order(0)
     {
         // Inicializujeme buffer se sentinelem na začátku (minimální hodnota)
-        for (size_t i = 0; i < BufferSize + 2; ++i)
+        for (size_t i = 1; i < BufferSize + 1; ++i)
         {
-            buffer[i].order = i - 1;
+            buffer[i].order = (OrderType)(i - 1);
             buffer[i].value = 0;
         }
         
         // Nastavíme sentinel hodnoty
-        buffer[0].value = 0;
-        buffer[0].order = -1;
-        buffer[BufferSize + 1].value = UINT32_MAX;
-        buffer[BufferSize + 1].order = -1;
+        buffer[0].value = std::numeric_limits<T>::lowest();
+        buffer[0].order = SentinelOrder;
+        buffer[BufferSize + 1].value = std::numeric_limits<T>::max();
+        buffer[BufferSize + 1].order = SentinelOrder;
     }
 
     /**
@@ -56,10 +74,10 @@ public:
      * 
      * @param value nová hodnota k vložení
      */
-    void insert(uint32_t value)
+    void insert(T value)
     {
         // Najdeme index nejstarší hodnoty (podle pořadí)
-        int index = 0;
+        size_t index = 0;
         for (size_t i = 1; i < BufferSize + 1; ++i)
         {
             if (current_order == buffer[i].order)
@@ -98,7 +116,52 @@ public:
         }
 
         // Zvyšujeme pořadí pro další měření (modulo)
-        current_order = (current_order + 1) % (int)BufferSize;
+        current_order = (OrderType)((current_order + 1) % BufferSize);
+    }
+
+    /**
+     * Vloží celý blok hodnot (např. rámec z DMA), výsledek je stejný jako
+     * při vkládání po jedné. Z bloku delšího než buffer se uplatní jen
+     * posledních BufferSize hodnot. Větší bloky se nevkládají bublinkou,
+     * ale jedním průchodem přepíšou nejstarší záznamy a buffer se přeřadí,
+     * tj. O(BufferSize log BufferSize) místo O(count * BufferSize).
+     * 
+     * @param values hodnoty v pořadí, jak byly změřeny
+     * @param count počet hodnot
+     */
+    void insertBulk(const T *values, size_t count)
+    {
+        if (count < BulkSortThreshold)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                insert(values[i]);
+            }
+            return;
+        }
+
+        if (count > BufferSize)
+        {
+            // Starší hodnoty by byly hned přepsány, jen posuneme pořadí
+            current_order = (OrderType)((current_order + (count - BufferSize)) % BufferSize);
+            values += count - BufferSize;
+            count = BufferSize;
+        }
+
+        // Záznam s pořadím current_order + k dostane k-tou hodnotu bloku
+        for (size_t i = 1; i < BufferSize + 1; ++i)
+        {
+            const size_t age = (buffer[i].order + BufferSize - current_order) % BufferSize;
+            if (age < count)
+            {
+                buffer[i].value = values[age];
+            }
+        }
+
+        std::sort(buffer + 1, buffer + BufferSize + 1,
+                  [](const BufferEntry &a, const BufferEntry &b) { return a.value < b.value; });
+
+        current_order = (OrderType)((current_order + count) % BufferSize);
     }
 
     /**
@@ -106,9 +169,9 @@ public:
      * 
      * @return oříznutý průměr
      */
-    uint32_t getValue() const
+    T getValue() const
     {
-        uint64_t sum = 0;
+        SumType sum = 0;
         
         // Sečteme hodnoty bez TrimCount nejmenších a TrimCount největších
         for (size_t i = 1 + TrimCount; i <= BufferSize - TrimCount; ++i)
@@ -116,7 +179,7 @@ public:
             sum += buffer[i].value;
         }
         
-        return sum / (BufferSize - 2 * TrimCount);
+        return (T)(sum / (SumType)(BufferSize - 2 * TrimCount));
     }
 
     /**
@@ -130,3 +193,179 @@ public:
     }
 
 };
+
+/**
+ * Oříznutý průměr pro velká okna (stovky až tisíce vzorků)
+ *
+ * Počítá totéž co TrimmedMean, ale místo seřazeného bufferu drží:
+ * - kruhový buffer vzorků v pořadí vložení (nejstarší je vždy na pozici head),
+ * - Fenwickův strom počtů přes obor hodnot (k-tý nejmenší v O(log V)),
+ * - průběžné součty TrimCount a BufferSize - TrimCount nejmenších hodnot.
+ * insert() je O(log V), getValue() O(1). Paměť roste s oborem hodnot
+ * (2^ValueBits počtů), ne s oknem - pro 12bitové ADC je to 8 KB.
+ * Pro malá okna (desítky prvků) je TrimmedMean rychlejší.
+ *
+ * Stejně jako TrimmedMean začíná s bufferem plným nul.
+ *
+ * Parametry template:
+ * - BufferSize: velikost okna
+ * - TrimCount: počet hodnot k odstranění z každé strany
+ * - ValueBits: šířka hodnot, větší hodnoty se ořežou na maximum
+ *
+ * Příklad:
+ *   FenwickTrimmedMean<1024, 128> adc_filter;  // 12bitové hodnoty
+ *   adc_filter.insert(raw_value);
+ *   uint32_t avg = adc_filter.getValue();
+ */
+template<size_t BufferSize = 31, size_t TrimCount = 5, unsigned ValueBits = 12>
+class FenwickTrimmedMean
+{
+private:
+    static_assert(TrimCount < BufferSize / 2, "TrimCount musí být menší než polovina BufferSize");
+    static_assert(BufferSize <= UINT16_MAX, "Počty ve stromu jsou 16bitové");
+    static_assert(ValueBits >= 1 && ValueBits <= 16, "ValueBits musí být 1 až 16");
+
+    static constexpr uint32_t ValueCount = 1u << ValueBits;
+    static constexpr uint32_t MaxValue = ValueCount - 1;
+    static constexpr uint32_t UpperRank = BufferSize - TrimCount;
+
+    uint16_t tree[ValueCount + 1];   // Fenwickův strom počtů, index = hodnota + 1
+    uint16_t ring[BufferSize];       // vzorky v pořadí vložení
+    size_t head;                     // pozice nejstaršího vzorku
+    uint64_t lower_sum;              // součet TrimCount nejmenších
+    uint64_t upper_sum;              // součet UpperRank nejmenších
+
+    void treeAdd(uint32_t value, int delta)
+    {
+        for (uint32_t i = value + 1; i <= ValueCount; i += i & (0u - i))
+        {
+            tree[i] = (uint16_t)(tree[i] + delta);
+        }
+    }
+
+    // Hodnota k-tého nejmenšího prvku (k od 1) sestupem stromem
+    uint32_t kth(uint32_t k) const
+    {
+        uint32_t pos = 0;
+        for (uint32_t step = ValueCount; step > 0; step >>= 1)
+        {
+            if (pos + step <= ValueCount && tree[pos + step] < k)
+            {
+                pos += step;
+                k -= tree[pos];
+            }
+        }
+        return pos;
+    }
+
+    // Počet prvků menších než value
+    uint32_t countBelow(uint32_t value) const
+    {
+        uint32_t count = 0;
+        for (uint32_t i = value; i > 0; i -= i & (0u - i))
+        {
+            count += tree[i];
+        }
+        return count;
+    }
+
+    /**
+     * Upraví součet k nejmenších při náhradě old_value za new_value.
+     * Volá se mezi odebráním old_value a přidáním new_value do stromu,
+     * was_inside říká, zda old_value patřila mezi k nejmenších.
+     */
+    void replaceInSum(uint64_t &sum, uint32_t k, bool was_inside, uint32_t old_value, uint32_t new_value) const
+    {
+        if (k == 0)
+        {
+            return;
+        }
+        if (k == BufferSize)
+        {
+            sum += (uint64_t)new_value - old_value;
+            return;
+        }
+
+        // k-tý nejmenší zbylých BufferSize - 1 prvků
+        const uint32_t boundary = kth(k);
+        if (was_inside)
+        {
+            sum = sum - old_value + boundary;
+        }
+        if (new_value < boundary)
+        {
+            sum = sum - boundary + new_value;
+        }
+    }
+
+public:
+    FenwickTrimmedMean() : head(0), lower_sum(0), upper_sum(0)
+    {
+        memset(tree, 0, sizeof(tree));
+        memset(ring, 0, sizeof(ring));
+        treeAdd(0, (int)BufferSize);
+    }
+
+    /**
+     * Nahradí nejstarší hodnotu novou
+     *
+     * @param value nová hodnota k vložení
+     */
+    void insert(uint32_t value)
+    {
+        if (value > MaxValue)
+        {
+            value = MaxValue;
+        }
+
+        const uint32_t old_value = ring[head];
+        ring[head] = (uint16_t)value;
+        head = (head + 1 == BufferSize) ? 0 : head + 1;
+
+        // Stejné hodnoty jsou zaměnitelné, stačí porovnat s počtem menších
+        const uint32_t below = countBelow(old_value);
+        const bool in_lower = below < TrimCount;
+        const bool in_upper = below < UpperRank;
+
+        treeAdd(old_value, -1);
+        replaceInSum(lower_sum, TrimCount, in_lower, old_value, value);
+        replaceInSum(upper_sum, UpperRank, in_upper, old_value, value);
+        treeAdd(value, 1);
+    }
+
+    /**
+     * Vloží blok hodnot (např. rámec z DMA) po jedné
+     *
+     * @param values hodnoty v pořadí, jak byly změřeny
+     * @param count počet hodnot
+     */
+    template<typename V>
+    void insertBulk(const V *values, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            insert((uint32_t)values[i]);
+        }
+    }
+
+    /**
+     * Vrátí oříznutý průměr (bez TrimCount nejmenších a největších)
+     *
+     * @return oříznutý průměr
+     */
+    uint32_t getValue() const
+    {
+        return (uint32_t)((upper_sum - lower_sum) / (BufferSize - 2 * TrimCount));
+    }
+
+    /**
+     * Vrátí velikost bufferu
+     *
+     * @return velikost bufferu
+     */
+    size_t getBufferSize() const
+    {
+        return BufferSize;
+    }
+
+};
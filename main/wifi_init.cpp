@@ -66,7 +66,7 @@ static void publish_network_event(bool wifi_up_hint)
         },
     };
 
-    if (!sensor_events_publish(&event, 0)) {
+    if (!sensor_events_publish(&event)) {
         ESP_LOGD(TAG, "Network event nebylo mozne publikovat");
     }
 }
@@ -21,10 +21,13 @@
 #include "restart_info.h"
 #include "sensor_events.h"
 #include "state_manager.h"
+#include "event_trace.h"
+#include "tick_scheduler.h"
 
 #include "lcd.h"
 #include "wifi_init.h"
 #include "mqtt_init.h"
+#include "diag_publisher.h"
 #include "config_webapp.h"
 
 #include "esp_partition.h"
@@ -64,6 +67,7 @@ void print_partitions(void)
 
 void cpp_app_main(void)
 {
+    event_trace_init();
     print_partitions();
     esp_err_t nvs_result = nvs_flash_init();
     if (nvs_result == ESP_ERR_NVS_NO_FREE_PAGES || nvs_result == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -81,7 +85,15 @@ void cpp_app_main(void)
         ESP_LOGI("main", "System bezi v normalnim rezimu");
     }
 
-    sensor_events_init(32);
+    sensor_events_init();
+
+    // Jeden casovac pro vsechny periodicke ulohy (vzorkovani senzoru, EVT_TICK, diagnostika)
+    ESP_ERROR_CHECK(tick_scheduler_start(10));
+
+    lcd_init(); // Inicializace LCD před spuštěním ostatních demo úloh, aby mohly ihned zobrazovat informace
+
+    // Odberatel sbernice se musi zaregistrovat pred WiFi, jinak by prvni sitove eventy nemel kdo prevzit
+    state_manager_start();
 
     char wifi_ssid[32] = {0};
     char wifi_password[64] = {0};
@@ -105,10 +117,16 @@ void cpp_app_main(void)
     const config_group_t config_groups[] = {
         app_config_get_config_group(),
         hladina_demo_get_config_group(),
+        prutokomer_get_config_group(),
+        teplota_demo_get_config_group(),
     };
 
     app_restart_info_t restart_info = {};
-    ESP_ERROR_CHECK(app_restart_info_update_and_load(&restart_info));
+    // Poskozeny sektor citace nesmi zastavit start, pocet startu je jen informace
+    const esp_err_t restart_info_result = app_restart_info_update_and_load(&restart_info);
+    if (restart_info_result != ESP_OK) {
+        ESP_LOGW("main", "Pocet startu neni k dispozici: %s", esp_err_to_name(restart_info_result));
+    }
 
     config_webapp_restart_info_t webapp_restart_info = {
         .boot_count = restart_info.boot_count,
@@ -130,6 +148,8 @@ void cpp_app_main(void)
         &webapp_network_info);
     if (config_result != ESP_OK) {
         ESP_LOGW("main", "Config web app se nepodarilo spustit: %s", esp_err_to_name(config_result));
+    } else if (event_trace_register_http() != ESP_OK) {
+        ESP_LOGW("main", "Trasovani eventu nebude dostupne na /trace");
     }
     
     if (!config_ap_mode) {
@@ -139,12 +159,9 @@ void cpp_app_main(void)
                  (mqtt_username[0] != '\0') ? mqtt_username : "(none)",
                  (mqtt_password[0] != '\0') ? "yes" : "no");
         ESP_ERROR_CHECK(mqtt_init(mqtt_uri, mqtt_username, mqtt_password));
+        ESP_ERROR_CHECK(diag_publisher_start(60000));
     }
     
-    lcd_init(); // Inicializace LCD před spuštěním ostatních demo úloh, aby mohly ihned zobrazovat informace
-
-    state_manager_start();
-    
     // initialize sensor producer tasks
     prutokomer_init();
 
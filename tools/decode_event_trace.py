@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Dekoder letoveho zaznamu eventu stazeneho z http://<zarizeni>/trace.bin.
+
+Pouziti: decode_event_trace.py event_trace.bin
+
+Format odpovida event_trace_dump_header_t a event_trace_record_t
+v main/event_trace.h (little-endian).
+"""
+
+import math
+import struct
+import sys
+
+DUMP_MAGIC = 0x52545645  # "EVTR"
+HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<IBBh8s")
+
+EVT_SENSOR, EVT_NETWORK, EVT_TICK = 0, 1, 2
+SENSOR_TEMPERATURE, SENSOR_LEVEL, SENSOR_FLOW = 0, 1, 2
+BOOT_MARKER = 0xFF
+LOST_RECORD = 0xFE
+
+NETWORK_LEVELS = ["down", "wifi_only", "ip_only", "mqtt_ready"]
+RESET_REASONS = ["unknown", "poweron", "ext", "sw", "panic", "int_wdt", "task_wdt",
+                 "wdt", "deepsleep", "brownout", "sdio", "usb", "jtag", "efuse",
+                 "pwr_glitch", "cpu_lockup"]
+
+
+def format_record(timestamp_ms, event_type, subtype, aux, payload):
+    ts = f"{timestamp_ms / 1000.0:10.3f}s"
+    f0, f1 = struct.unpack("<ff", payload)
+    u0, _ = struct.unpack("<II", payload)
+
+    if event_type == BOOT_MARKER:
+        reason = RESET_REASONS[subtype] if subtype < len(RESET_REASONS) else str(subtype)
+        return f"--- start, reset_reason={reason} ---"
+    if event_type == LOST_RECORD:
+        return "--- zaznam prepsan behem stahovani ---"
+    if event_type == EVT_SENSOR:
+        if subtype == SENSOR_TEMPERATURE:
+            return f"{ts} temperature temp={f0:.2f}C"
+        if subtype == SENSOR_LEVEL:
+            volume = "n/a" if math.isnan(f1) else f"{f1:.1f}l"
+            return f"{ts} level raw={aux & 0xFFFF} height={f0:.3f}m volume={volume}"
+        if subtype == SENSOR_FLOW:
+            return f"{ts} flow flow={f0:.2f} l/min total={f1:.2f} l"
+        return f"{ts} sensor_unknown({subtype})"
+    if event_type == EVT_NETWORK:
+        level = NETWORK_LEVELS[subtype] if subtype < len(NETWORK_LEVELS) else str(subtype)
+        ip = ".".join(str((u0 >> shift) & 0xFF) for shift in (0, 8, 16, 24))
+        return f"{ts} network level={level} rssi={aux} ip={ip}"
+    if event_type == EVT_TICK:
+        return f"{ts} tick"
+    return f"{ts} unknown({event_type})"
+
+
+def main(argv):
+    if len(argv) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    with open(argv[1], "rb") as dump:
+        data = dump.read()
+
+    if len(data) < HEADER.size:
+        print("Soubor je kratsi nez hlavicka", file=sys.stderr)
+        return 1
+
+    magic, version, record_size, record_count, write_index = HEADER.unpack_from(data, 0)
+    if magic != DUMP_MAGIC:
+        print(f"Neplatna signatura 0x{magic:08x}", file=sys.stderr)
+        return 1
+    if version != 1 or record_size != RECORD.size:
+        print(f"Nepodporovana verze {version} / velikost zaznamu {record_size}", file=sys.stderr)
+        return 1
+
+    available = (len(data) - HEADER.size) // record_size
+    if available < record_count:
+        print(f"Varovani: hlavicka hlasi {record_count} zaznamu, v souboru je {available}", file=sys.stderr)
+        record_count = available
+
+    print(f"# zaznamu: {record_count}, celkem zapsano: {write_index}")
+    for index in range(record_count):
+        fields = RECORD.unpack_from(data, HEADER.size + index * record_size)
+        print(format_record(*fields))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))